@@ -27,28 +27,48 @@
 // Project Includes
 #include <buildvars.h>
 #include "cli.h"
+#include "control.h"
 #include <led.h>
 #include <print.h>
 
 
 
+// ----- Macros -----
+
+// Name of a command index entry
+#define CLI_indexName(index) ( (char*)CLIDict[ CLIIndex[index].dict ][ CLIIndex[index].cmd ].name )
+
+
+
+// ----- Function Declarations -----
+
+// Optional Debug sub-modules, weak so builds without them still link
+void Trace_setup()   __attribute__ ((weak));
+void Trace_process() __attribute__ ((weak));
+
+
+
 // ----- Variables -----
 
 // Basic command dictionary
+CLIDict_Entry( batch,    "Enables/Disables batch mode. No echo, prompt or history; each command is followed by !<status>." NL "\t\t0 Ok, 1 Unknown command, 2 Line too long. Arg sets the mode, otherwise toggles." );
 CLIDict_Entry( clear, "Clear the screen.");
 CLIDict_Entry( cliDebug, "Enables/Disables hex output of the most recent cli input." );
 CLIDict_Entry( help,     "You're looking at it :P" );
 CLIDict_Entry( led,      "Enables/Disables indicator LED. Try a couple times just in case the LED is in an odd state.\r\n\t\t\033[33mWarning\033[0m: May adversely affect some modules..." );
+CLIDict_Entry( logLevel, "Show/Set the runtime log level:" NL "\t\t0 None, 1 Error, 2 Warning, 3 Info, 4 Debug (limited by the compile-time level)" );
 CLIDict_Entry( reload,   "Signals microcontroller to reflash/reload." );
 CLIDict_Entry( reset,    "Resets the terminal back to initial settings." );
 CLIDict_Entry( restart,  "Sends a software restart, should be similar to powering on the device." );
 CLIDict_Entry( version,  "Version information about this firmware." );
 
 CLIDict_Def( basicCLIDict, "General Commands" ) = {
+	CLIDict_Item( batch ),
 	CLIDict_Item( clear ),
 	CLIDict_Item( cliDebug ),
 	CLIDict_Item( help ),
 	CLIDict_Item( led ),
+	CLIDict_Item( logLevel ),
 	CLIDict_Item( reload ),
 	CLIDict_Item( reset ),
 	CLIDict_Item( restart ),
@@ -66,6 +86,17 @@ inline void prompt()
 	print("\033[1;34m:\033[0m "); // Blue bold prompt
 }
 
+// Passes the character to the binary control protocol if it is part of a frame
+// Frames may only start at the beginning of a line
+inline uint8_t CLI_controlFrame( char cur_char )
+{
+	if ( !Control_receiving() && ( cur_char != Control_FrameStart || CLILineBufferCurrent != 0 ) )
+		return 0;
+
+	Control_receive( (uint8_t)cur_char );
+	return 1;
+}
+
 // Initialize the CLI
 inline void CLI_init()
 {
@@ -82,6 +113,7 @@ inline void CLI_init()
 
 	// Register first dictionary
 	CLIDictionariesUsed = 0;
+	CLIIndexUsed = 0;
 	CLI_registerDictionary( basicCLIDict, basicCLIDictName );
 
 	// Initialize main LED
@@ -90,6 +122,14 @@ inline void CLI_init()
 
 	// Hex debug mode is off by default
 	CLIHexDebugMode = 0;
+
+	// Interactive by default
+	CLIBatchMode = 0;
+	CLIBatchOverflow = 0;
+
+	// Trace module, if available
+	if ( Trace_setup )
+		Trace_setup();
 }
 
 // Query the serial input buffer for any new characters
@@ -98,6 +138,17 @@ void CLI_process()
 	// Current buffer position
 	uint8_t prev_buf_pos = CLILineBufferCurrent;
 
+	// Send any buffered trace records
+	if ( Trace_process )
+		Trace_process();
+
+	// Batch mode has its own, non-interactive, line processing
+	if ( CLIBatchMode )
+	{
+		CLI_batchProcess();
+		return;
+	}
+
 	// Process each character while available
 	while ( 1 )
 	{
@@ -108,6 +159,10 @@ void CLI_process()
 		// Retrieve from output module
 		char cur_char = (char)Output_getchar();
 
+		// Binary control frames never reach the line buffer
+		if ( CLI_controlFrame( cur_char ) )
+			continue;
+
 		// Make sure buffer isn't full
 		if ( CLILineBufferCurrent >= CLILineBufferMaxSize )
 		{
@@ -189,8 +244,10 @@ void CLI_process()
 			CLILineBufferCurrent = 0;
 
 			// Reset the prompt after processing has finished
+			// Unless the command switched to batch mode
 			print( NL );
-			prompt();
+			if ( !CLIBatchMode )
+				prompt();
 
 			// XXX There is a potential bug here when resetting the buffer (losing valid keypresses)
 			//     Doesn't look like it will happen *that* often, so not handling it for now -HaaTa
@@ -272,6 +329,59 @@ void CLI_process()
 	}
 }
 
+// Batch mode line processing
+// Every complete line is run as soon as it is received, so several commands can arrive in a single packet
+// The command output is followed by NL "!<status>" NL, with no echo, prompt or history
+void CLI_batchProcess()
+{
+	while ( Output_availablechar() > 0 )
+	{
+		char cur_char = (char)Output_getchar();
+
+		// Binary control frames never reach the line buffer
+		if ( CLI_controlFrame( cur_char ) )
+			continue;
+
+		// Not the end of a line, store the character
+		if ( cur_char != 0x0A && cur_char != 0x0D )
+		{
+			// Drop the rest of the line if it doesn't fit (leaving room for the trailing space), reported at the end of the line
+			if ( CLILineBufferCurrent >= CLILineBufferMaxSize - 1 )
+				CLIBatchOverflow = 1;
+			else
+				CLILineBuffer[CLILineBufferCurrent++] = cur_char;
+			continue;
+		}
+
+		// Blank lines (and the second half of CR LF) are ignored
+		if ( CLILineBufferCurrent == 0 && !CLIBatchOverflow )
+			continue;
+
+		uint8_t status = CLIStatus_Overflow;
+		if ( !CLIBatchOverflow )
+		{
+			// Trailing space, same as the interactive mode, resolves a bug in args
+			CLILineBuffer[CLILineBufferCurrent++] = ' ';
+			status = CLI_commandLookup();
+		}
+
+		// Reset the buffer
+		CLILineBufferCurrent = 0;
+		CLIBatchOverflow = 0;
+
+		print( NL "!" );
+		printInt8( status );
+		print( NL );
+
+		// Batch mode was disabled by the command, back to the interactive prompt
+		if ( !CLIBatchMode )
+		{
+			prompt();
+			return;
+		}
+	}
+}
+
 // Takes a string, returns two pointers
 //  One to the first non-space character
 //  The second to the next argument (first NULL if there isn't an argument). delimited by a space
@@ -297,11 +407,12 @@ void CLI_argumentIsolation( char* string, char** first, char** second )
 }
 
 // Scans the CLILineBuffer for any valid commands
-void CLI_commandLookup()
+// Returns a CLIStatus code
+uint8_t CLI_commandLookup()
 {
 	// Ignore command if buffer is 0 length
 	if ( CLILineBufferCurrent == 0 )
-		return;
+		return CLIStatus_Ok;
 
 	// Set the last+1 character of the buffer to NULL for string processing
 	CLILineBuffer[CLILineBufferCurrent] = '\0';
@@ -312,27 +423,27 @@ void CLI_commandLookup()
 	char* argPtr;
 	CLI_argumentIsolation( CLILineBuffer, &cmdPtr, &argPtr );
 
-	// Scan array of dictionaries for a valid command match
-	for ( uint8_t dict = 0; dict < CLIDictionariesUsed; dict++ )
+	// Binary search the command index, abbreviations of a single command are accepted too
+	uint8_t index = CLI_commandFind( cmdPtr );
+	if ( index < CLIIndexUsed )
 	{
-		// Parse each cmd until a null command entry is found, or an argument match
-		for ( uint8_t cmd = 0; CLIDict[dict][cmd].name != 0; cmd++ )
-		{
-			// Compare the first argument and each command entry
-			if ( eqStr( cmdPtr, (char*)CLIDict[dict][cmd].name ) == -1 )
-			{
-				// Run the specified command function pointer
-				//   argPtr is already pointing at the first character of the arguments
-				(*(void (*)(char*))CLIDict[dict][cmd].function)( argPtr );
+		// Run the specified command function pointer
+		//   argPtr is already pointing at the first character of the arguments
+		CLIDictItem *item = &CLIDict[ CLIIndex[index].dict ][ CLIIndex[index].cmd ];
+		(*(void (*)(char*))item->function)( argPtr );
 
-				return;
-			}
-		}
+		return CLIStatus_Ok;
 	}
 
 	// No match for the command...
-	print( NL );
-	erro_dPrint("\"", CLILineBuffer, "\" is not a valid command...type \033[35mhelp\033[0m");
+	// Batch mode only reports the status code
+	if ( !CLIBatchMode )
+	{
+		print( NL );
+		erro_dPrint("\"", CLILineBuffer, "\" is not a valid command...type \033[35mhelp\033[0m");
+	}
+
+	return CLIStatus_Unknown;
 }
 
 // Registers a command dictionary with the CLI
@@ -347,7 +458,98 @@ void CLI_registerDictionary( const CLIDictItem *cmdDict, const char* dictName )
 
 	// Add dictionary
 	CLIDictNames[CLIDictionariesUsed] = (char*)dictName;
-	CLIDict[CLIDictionariesUsed++] = (CLIDictItem*)cmdDict;
+	CLIDict[CLIDictionariesUsed] = (CLIDictItem*)cmdDict;
+
+	// Insert each command into the sorted index
+	// Commands are placed after any existing entry of the same name, so the first registered one still wins
+	for ( uint8_t cmd = 0; cmdDict[cmd].name != 0; cmd++ )
+	{
+		if ( CLIIndexUsed >= CLIMaxCommands )
+		{
+			erro_print("Max number of commands indexed already...");
+			break;
+		}
+
+		// Find the insertion point, after all entries less than or equal to the new name
+		uint8_t pos = CLIIndexUsed;
+		while ( pos > 0 && CLI_compareStr( (char*)cmdDict[cmd].name, CLI_indexName( pos - 1 ) ) < 0 )
+		{
+			CLIIndex[pos] = CLIIndex[pos - 1];
+			pos--;
+		}
+
+		CLIIndex[pos].dict = CLIDictionariesUsed;
+		CLIIndex[pos].cmd  = cmd;
+		CLIIndexUsed++;
+	}
+
+	CLIDictionariesUsed++;
+}
+
+// Compares two strings, returns <0, 0 or >0 (same ordering as strcmp)
+int CLI_compareStr( char* str1, char* str2 )
+{
+	while ( *str1 != '\0' && *str1 == *str2 )
+	{
+		str1++;
+		str2++;
+	}
+
+	return (uint8_t)*str1 - (uint8_t)*str2;
+}
+
+// Returns 1 if str starts with prefix
+uint8_t CLI_prefixStr( char* prefix, char* str )
+{
+	while ( *prefix != '\0' )
+	{
+		if ( *prefix++ != *str++ )
+			return 0;
+	}
+
+	return 1;
+}
+
+// Binary search of the command index
+// Returns the position of the first entry that is not less than the given name (CLIIndexUsed if none)
+uint8_t CLI_indexSearch( char* name )
+{
+	uint8_t low = 0;
+	uint8_t high = CLIIndexUsed;
+
+	while ( low < high )
+	{
+		uint8_t mid = ( low + high ) / 2;
+		if ( CLI_compareStr( CLI_indexName( mid ), name ) < 0 )
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+// Finds the command to run
+// An exact match, otherwise the only command starting with name (e.g. ver runs version)
+// Returns the position in the command index, CLIIndexUsed if there is no such command
+uint8_t CLI_commandFind( char* name )
+{
+	if ( *name == '\0' )
+		return CLIIndexUsed;
+
+	uint8_t index = CLI_indexSearch( name );
+	if ( index >= CLIIndexUsed || !CLI_prefixStr( name, CLI_indexName( index ) ) )
+		return CLIIndexUsed;
+
+	// Exact match, the first registered one if several dictionaries use the name
+	if ( CLI_compareStr( name, CLI_indexName( index ) ) == 0 )
+		return index;
+
+	// Abbreviation, must not be the start of any other command
+	if ( index + 1 < CLIIndexUsed && CLI_prefixStr( name, CLI_indexName( index + 1 ) ) )
+		return CLIIndexUsed;
+
+	return index;
 }
 
 inline void CLI_tabCompletion()
@@ -369,23 +571,23 @@ inline void CLI_tabCompletion()
 	char* tabMatch = 0;
 	uint8_t matches = 0;
 
-	// Scan array of dictionaries for a valid command match
-	for ( uint8_t dict = 0; dict < CLIDictionariesUsed; dict++ )
+	// All commands starting with the first argument piece are adjacent in the sorted index
+	// NOTE: To save on processing, we only care about the commands and ignore the arguments
+	//       If there are arguments, and a valid tab match is found, buffer is cleared (args lost)
+	//       Also ignores full matches
+	for ( uint8_t index = CLI_indexSearch( cmdPtr ); index < CLIIndexUsed; index++ )
 	{
-		// Parse each cmd until a null command entry is found, or an argument match
-		for ( uint8_t cmd = 0; CLIDict[dict][cmd].name != 0; cmd++ )
-		{
-			// Compare the first argument piece to each command entry to see if it is "like"
-			// NOTE: To save on processing, we only care about the commands and ignore the arguments
-			//       If there are arguments, and a valid tab match is found, buffer is cleared (args lost)
-			//       Also ignores full matches
-			if ( eqStr( cmdPtr, (char*)CLIDict[dict][cmd].name ) == 0 )
-			{
-				// TODO Make list of commands if multiple matches
-				matches++;
-				tabMatch = (char*)CLIDict[dict][cmd].name;
-			}
-		}
+		// Past the end of the prefix range
+		if ( !CLI_prefixStr( cmdPtr, CLI_indexName( index ) ) )
+			break;
+
+		// Full match, skip
+		if ( CLI_compareStr( cmdPtr, CLI_indexName( index ) ) == 0 )
+			continue;
+
+		// TODO Make list of commands if multiple matches
+		matches++;
+		tabMatch = CLI_indexName( index );
 	}
 
 	// Only tab complete if there was 1 match
@@ -460,6 +662,27 @@ void CLI_retreiveHistory( int index )
 
 // ----- CLI Command Functions -----
 
+void cliFunc_batch( char* args )
+{
+	// Parse number from argument
+	//  NOTE: Only first argument is used
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+	// Set the mode if given, otherwise toggle
+	uint8_t mode = arg1Ptr[0] != '\0' ? numToInt( arg1Ptr ) != 0 : !CLIBatchMode;
+
+	// Only announce when entering from the interactive mode, batch mode responses are just the status
+	if ( mode && !CLIBatchMode )
+	{
+		print( NL );
+		info_print("Batch mode enabled...");
+	}
+
+	CLIBatchMode = mode;
+}
+
 void cliFunc_clear( char* args)
 {
 	print("\033[2J\033[H\r"); // Erases the whole screen
@@ -515,6 +738,28 @@ void cliFunc_led( char* args )
 	errorLED( CLILEDState ); // Enable/Disable error LED
 }
 
+void cliFunc_logLevel( char* args )
+{
+	// Parse number from argument
+	//  NOTE: Only first argument is used
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+	// Set the level if given, otherwise just display it
+	if ( arg1Ptr[0] != '\0' )
+	{
+		Print_logLevel = numToInt( arg1Ptr );
+	}
+
+	print( NL );
+	info_msg("Log Level: ");
+	printInt8( Print_logLevel );
+	print(" (Compile-time: ");
+	printInt8( LogLevel_define );
+	print(")");
+}
+
 void cliFunc_reload( char* args )
 {
 	// Request to output module to be set into firmware reload mode
@@ -34,9 +34,15 @@
 
 #define CLILineBufferMaxSize 100
 #define CLIMaxDictionaries   10
+#define CLIMaxCommands       128
 #define CLIEntryTabAlign     13
 #define CLIMaxHistorySize    10
 
+// Batch mode status codes, sent after each command as !<code>
+#define CLIStatus_Ok       0
+#define CLIStatus_Unknown  1
+#define CLIStatus_Overflow 2
+
 
 // ----- Macros -----
 
@@ -79,6 +85,12 @@ typedef struct CLIDictItem {
 	const void (*function)(char*);
 } CLIDictItem;
 
+// Sorted command index entry, dictionary and item position of a command
+typedef struct CLIIndexItem {
+	uint8_t dict;
+	uint8_t cmd;
+} CLIIndexItem;
+
 
 
 // ----- Variables -----
@@ -91,6 +103,10 @@ CLIDictItem *CLIDict     [CLIMaxDictionaries];
 char*        CLIDictNames[CLIMaxDictionaries];
 uint8_t      CLIDictionariesUsed;
 
+// Command index across all dictionaries, sorted by name
+CLIIndexItem CLIIndex[CLIMaxCommands];
+uint8_t      CLIIndexUsed;
+
 // History
 char CLIHistoryBuffer[CLIMaxHistorySize][CLILineBufferMaxSize];
 uint8_t CLIHistoryHead;
@@ -101,6 +117,10 @@ int8_t CLIHistoryCurrent;
 uint8_t CLILEDState;
 uint8_t CLIHexDebugMode;
 
+// Batch mode (no echo/prompt/history, status code after each command)
+uint8_t CLIBatchMode;
+uint8_t CLIBatchOverflow;
+
 
 
 // ----- Functions and Corresponding Function Aliases -----
@@ -111,19 +131,27 @@ void CLI_registerDictionary( const CLIDictItem *cmdDict, const char* dictName );
 void CLI_argumentIsolation( char* string, char** first, char** second );
 
 int CLI_wrap( int x, int low, int high );
-void CLI_commandLookup();
+uint8_t CLI_commandLookup();
+void CLI_batchProcess();
+uint8_t CLI_controlFrame( char cur_char );
+int CLI_compareStr( char* str1, char* str2 );
+uint8_t CLI_prefixStr( char* prefix, char* str );
+uint8_t CLI_indexSearch( char* name );
+uint8_t CLI_commandFind( char* name );
 void CLI_tabCompletion();
 void CLI_saveHistory( char *buff );
 void CLI_retreiveHistory( int index );
 
 // CLI Command Functions
 void cliFunc_arch    ( char* args );
+void cliFunc_batch   ( char* args );
 void cliFunc_chip    ( char* args );
 void cliFunc_clear   ( char* args );
 void cliFunc_cliDebug( char* args );
 void cliFunc_device  ( char* args );
 void cliFunc_help    ( char* args );
 void cliFunc_led     ( char* args );
+void cliFunc_logLevel( char* args );
 void cliFunc_reload  ( char* args );
 void cliFunc_reset   ( char* args );
 void cliFunc_restart ( char* args );
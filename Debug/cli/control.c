@@ -0,0 +1,215 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- Includes -----
+
+// Project Includes
+#include <output_com.h>
+
+// Local Includes
+#include "control.h"
+
+
+
+// ----- Function Declarations -----
+
+uint8_t Control_ping( uint8_t* data, uint8_t len );
+
+
+
+// ----- Variables -----
+
+// Core requests
+const ControlItem controlCoreDict[] = {
+	{ ControlId_Ping, Control_ping },
+	{ 0, 0 } // Null entry for dictionary end
+};
+
+// Registered request dictionaries, core dictionary is always first
+ControlItem *ControlDict[ControlMaxDictionaries] = { (ControlItem*)controlCoreDict };
+uint8_t      ControlDictionariesUsed = 1;
+
+// Request being received
+//  0        - Idle
+//  1        - STX received, next is the id
+//  2        - Length is next
+//  3+       - Data, then checksum
+uint16_t Control_rxPos = 0;
+uint8_t  Control_rxId;
+uint8_t  Control_rxLen;
+uint8_t  Control_rxSum;
+uint8_t  Control_rxData[ControlMaxPayload];
+
+// Response being sent
+uint8_t  Control_txSum;
+uint8_t  Control_txStarted;
+uint16_t Control_txRemaining;
+
+
+
+// ----- Functions -----
+
+// Registers a request dictionary
+void Control_registerDictionary( const ControlItem *ctrlDict )
+{
+	// Make sure this max limit of dictionaries hasn't been reached
+	if ( ControlDictionariesUsed >= ControlMaxDictionaries )
+		return;
+
+	ControlDict[ControlDictionariesUsed++] = (ControlItem*)ctrlDict;
+}
+
+// Returns 1 if a frame is partially received, all bytes must go to Control_receive until it is complete
+uint8_t Control_receiving()
+{
+	return Control_rxPos != 0;
+}
+
+// Sends a single response byte
+inline void Control_putbyte( uint8_t byte )
+{
+	Control_txSum += byte;
+	Output_putchar( (char)byte );
+}
+
+// Starts the response, must be called (at most once) by the handler before any Control_write
+// Handlers that don't call it, send an empty response
+void Control_replyBegin( uint16_t len )
+{
+	if ( Control_txStarted )
+		return;
+
+	Output_putchar( Control_FrameStart );
+	Control_txSum = 0;
+	Control_putbyte( Control_rxId );
+	Control_putbyte( (uint8_t)len );
+	Control_putbyte( (uint8_t)(len >> 8) );
+
+	Control_txStarted = 1;
+	Control_txRemaining = len;
+}
+
+// Sends response data, anything past the length given to Control_replyBegin is discarded
+void Control_write( const uint8_t* data, uint16_t len )
+{
+	while ( len-- > 0 && Control_txRemaining > 0 )
+	{
+		Control_putbyte( *data++ );
+		Control_txRemaining--;
+	}
+}
+
+// Runs the handler of a complete request and terminates the response
+void Control_dispatch( uint8_t status )
+{
+	Control_txStarted = 0;
+
+	// Lookup the handler, unless the request was already rejected
+	if ( status == ControlStatus_Ok )
+	{
+		status = ControlStatus_Unknown;
+		for ( uint8_t dict = 0; dict < ControlDictionariesUsed && status == ControlStatus_Unknown; dict++ )
+		{
+			for ( uint8_t item = 0; ControlDict[dict][item].function != 0; item++ )
+			{
+				if ( ControlDict[dict][item].id == Control_rxId )
+				{
+					status = ControlDict[dict][item].function( Control_rxData, Control_rxLen );
+					break;
+				}
+			}
+		}
+	}
+
+	// Empty response if the handler didn't send anything
+	Control_replyBegin( 0 );
+
+	// Pad out a short response, so the host never has to resync
+	while ( Control_txRemaining > 0 )
+	{
+		Control_putbyte( 0 );
+		Control_txRemaining--;
+	}
+
+	Control_putbyte( status );
+	Output_putchar( (char)( -Control_txSum ) );
+}
+
+// Feeds a received byte into the request frame
+void Control_receive( uint8_t byte )
+{
+	switch ( Control_rxPos )
+	{
+	// Start of frame
+	case 0:
+		if ( byte == Control_FrameStart )
+			Control_rxPos = 1;
+		return;
+
+	// Request id
+	case 1:
+		Control_rxId = byte;
+		Control_rxSum = byte;
+		Control_rxPos = 2;
+		return;
+
+	// Data length
+	case 2:
+		Control_rxSum += byte;
+		Control_rxLen = byte;
+		Control_rxPos = 3;
+		return;
+	}
+
+	Control_rxSum += byte;
+
+	// Data
+	// A request that is too large is still consumed up to its checksum, so none of it reaches the CLI as text
+	if ( Control_rxPos - 3 < Control_rxLen )
+	{
+		if ( Control_rxLen <= ControlMaxPayload )
+			Control_rxData[ Control_rxPos - 3 ] = byte;
+		Control_rxPos++;
+		return;
+	}
+
+	// Checksum, frame complete
+	Control_rxPos = 0;
+	if ( Control_rxLen > ControlMaxPayload )
+		Control_dispatch( ControlStatus_BadArgs );
+	else
+		Control_dispatch( Control_rxSum == 0 ? ControlStatus_Ok : ControlStatus_BadChecksum );
+}
+
+
+
+// ----- Control Request Functions -----
+
+uint8_t Control_ping( uint8_t* data, uint8_t len )
+{
+	const uint8_t reply[] = { Control_Version, ControlMaxPayload };
+
+	Control_replyBegin( sizeof( reply ) );
+	Control_write( reply, sizeof( reply ) );
+
+	return ControlStatus_Ok;
+}
+
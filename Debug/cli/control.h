@@ -0,0 +1,89 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/MainLib.h>
+
+
+
+// ----- Defines -----
+
+// Binary control protocol, shares the serial stream with the text CLI
+// A frame is only recognized when the CLI line buffer is empty
+//
+// Request:  STX <id> <len> <data[len]> <checksum>
+// Response: STX <id> <len lo> <len hi> <data[len]> <status> <checksum>
+//
+// The checksum makes the 8 bit sum of every byte after STX zero
+// See control.py for the host side library
+#define Control_FrameStart     0x02
+#define Control_Version        1
+#define ControlMaxPayload      64
+#define ControlMaxDictionaries 8
+
+// Response status codes
+#define ControlStatus_Ok          0
+#define ControlStatus_Unknown     1 // No handler for the id
+#define ControlStatus_BadChecksum 2
+#define ControlStatus_BadArgs     3
+
+
+
+// ----- Enums -----
+
+// Request ids, handlers are registered by the module owning the data
+typedef enum ControlId {
+	ControlId_Ping        = 0x00, // CLI    - Returns <version> <max payload>
+	ControlId_ScanArray   = 0x10, // Scan   - Returns one byte per key, prevState << 4 | curState
+	ControlId_ScanCapture = 0x11, // Scan   - Optional <enable>, returns <dropped u32> <capture records> (MatrixARM)
+	ControlId_KeyEvent    = 0x20, // Macro  - Takes <scancode> <state> pairs (0x01 press, 0x03 release)
+	ControlId_LayerRead   = 0x21, // Macro  - Returns <count u16> <LayerState[count]> <stack size u16> <stack u16[size]>
+	ControlId_LayerWrite  = 0x22, // Macro  - Takes <layer u16> <state> triples
+	ControlId_UsbCounters = 0x30, // Output - Returns <coalesced reports u32> <free packets u32>
+} ControlId;
+
+
+
+// ----- Structs -----
+
+// Each item has an id and a handler for the request data
+// The handler returns a status code, and calls Control_replyBegin/Control_write for any response data
+typedef struct ControlItem {
+	uint8_t id;
+	uint8_t (*function)( uint8_t* data, uint8_t len );
+} ControlItem;
+
+
+
+// ----- Functions -----
+
+void Control_registerDictionary( const ControlItem *ctrlDict );
+
+uint8_t Control_receiving();
+void Control_receive( uint8_t byte );
+
+void Control_replyBegin( uint16_t len );
+void Control_write( const uint8_t* data, uint16_t len );
+
@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+'''
+Host side library for the binary control protocol (see control.h)
+
+Usage:
+  control.py <serial device> ping
+  control.py <serial device> scan
+  control.py <serial device> press <scancode> [<scancode>...]
+  control.py <serial device> release <scancode> [<scancode>...]
+  control.py <serial device> layers
+  control.py <serial device> layer <layer> <state>
+  control.py <serial device> usb
+  control.py <serial device> bench [count]
+
+As a library:
+  with Control( '/dev/ttyACM0' ) as ctrl:
+      states = ctrl.scan_array()
+'''
+
+# Copyright (C) 2015 by Jacob Alexander
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+# Imports
+import os
+import struct
+import sys
+import termios
+import time
+
+
+
+# Constants
+FRAME_START = 0x02
+
+# Longest response waited for, a stray FRAME_START with a larger length is skipped
+MAX_RESPONSE_LENGTH = 4096
+
+# Request ids, must match ControlId in control.h
+ID_PING         = 0x00
+ID_SCAN_ARRAY   = 0x10
+ID_SCAN_CAPTURE = 0x11
+ID_KEY_EVENT    = 0x20
+ID_LAYER_READ   = 0x21
+ID_LAYER_WRITE  = 0x22
+ID_USB_COUNTERS = 0x30
+
+STATUS = {
+	0: "Ok",
+	1: "Unknown request",
+	2: "Bad checksum",
+	3: "Bad arguments",
+}
+
+KEY_STATES = "OPHRI"
+
+
+
+# Classes
+class ControlError( Exception ):
+	'''
+	Non-Ok response status, or a broken response frame
+	'''
+
+
+class Control:
+	'''
+	Binary control protocol connection to a keyboard CDC serial device
+	'''
+
+	def __init__( self, device, timeout=1.0 ):
+		self.fd = os.open( device, os.O_RDWR | os.O_NOCTTY )
+		self.timeout = timeout
+
+		# Bytes read ahead, put back while looking for a response frame
+		self.pending = b""
+
+		# Raw mode, reads return as soon as anything is available
+		attrs = termios.tcgetattr( self.fd )
+		attrs[0] = 0 # iflag
+		attrs[1] = 0 # oflag
+		attrs[3] = 0 # lflag
+		attrs[6][termios.VMIN] = 0
+		attrs[6][termios.VTIME] = 1
+		termios.tcsetattr( self.fd, termios.TCSANOW, attrs )
+		termios.tcflush( self.fd, termios.TCIFLUSH )
+
+		# Frames are only recognized at the start of a line, finish anything left on the CLI line
+		os.write( self.fd, b"\r" )
+		time.sleep( 0.05 )
+		termios.tcflush( self.fd, termios.TCIFLUSH )
+
+	def __enter__( self ):
+		return self
+
+	def __exit__( self, *args ):
+		self.close()
+
+	def close( self ):
+		os.close( self.fd )
+
+	def _read( self, count, deadline ):
+		data = self.pending[:count]
+		self.pending = self.pending[count:]
+		while len( data ) < count:
+			if time.time() > deadline:
+				raise ControlError( "Timeout" )
+			data += os.read( self.fd, count - len( data ) )
+		return data
+
+	def request( self, request_id, data=b"" ):
+		'''
+		Sends a request and returns the response data
+		Raises ControlError for any status other than Ok
+		'''
+		if len( data ) > 255:
+			raise ControlError( "Request too large" )
+
+		# Checksum makes the sum of everything after STX zero
+		frame = bytes( [ request_id, len( data ) ] ) + bytes( data )
+		frame = bytes( [ FRAME_START ] ) + frame + bytes( [ -sum( frame ) & 0xFF ] )
+		os.write( self.fd, frame )
+
+		# Skip anything else in the stream (e.g. trace records or CLI output) until the response starts
+		# A FRAME_START byte that doesn't begin a valid response is skipped, the bytes after it are scanned again
+		deadline = time.time() + self.timeout
+		while True:
+			while self._read( 1, deadline )[0] != FRAME_START:
+				pass
+
+			header = self._read( 3, deadline )
+			if header[0] != request_id:
+				self.pending = header + self.pending
+				continue
+
+			length = header[1] | header[2] << 8
+			if length > MAX_RESPONSE_LENGTH:
+				self.pending = header + self.pending
+				continue
+
+			body = self._read( length + 2, deadline )
+			if ( sum( header ) + sum( body ) ) & 0xFF != 0:
+				self.pending = header + body + self.pending
+				continue
+
+			status = body[-2]
+			if status != 0:
+				raise ControlError( STATUS.get( status, "Status {0}".format( status ) ) )
+
+			return body[:-2]
+
+	def ping( self ):
+		'''
+		Returns (protocol version, max request payload)
+		'''
+		version, max_payload = self.request( ID_PING )
+		return version, max_payload
+
+	def scan_array( self ):
+		'''
+		Returns a list of (previous state, current state) per key
+		'''
+		return [ ( state >> 4, state & 0x0F ) for state in self.request( ID_SCAN_ARRAY ) ]
+
+	def key_events( self, events ):
+		'''
+		Sends a list of (scancode, state) events, 0x01 press, 0x03 release
+		'''
+		data = bytes( byte for event in events for byte in event )
+		for pos in range( 0, len( data ), 64 ):
+			self.request( ID_KEY_EVENT, data[ pos:pos + 64 ] )
+
+	def layers( self ):
+		'''
+		Returns (list of layer states, layer stack)
+		'''
+		data = self.request( ID_LAYER_READ )
+		count, = struct.unpack_from( "<H", data, 0 )
+		states = list( data[ 2:2 + count ] )
+		size, = struct.unpack_from( "<H", data, 2 + count )
+		stack = list( struct.unpack_from( "<{0}H".format( size ), data, 4 + count ) )
+		return states, stack
+
+	def set_layer( self, layer, state ):
+		'''
+		Sets the state bits of a layer (0x01 Shift, 0x02 Latch, 0x04 Lock)
+		'''
+		self.request( ID_LAYER_WRITE, struct.pack( "<HB", layer, state ) )
+
+	def usb_counters( self ):
+		'''
+		Returns (coalesced keyboard reports, free USB packets)
+		'''
+		return struct.unpack( "<II", self.request( ID_USB_COUNTERS ) )
+
+
+
+# Main
+def main( argv ):
+	if len( argv ) < 3:
+		print( __doc__ )
+		return 1
+
+	with Control( argv[1] ) as ctrl:
+		cmd = argv[2]
+		args = [ int( arg, 0 ) for arg in argv[3:] ]
+
+		if cmd == "ping":
+			print( "Version {0}, max payload {1}".format( *ctrl.ping() ) )
+		elif cmd == "scan":
+			print( " ".join( "{0:02X}:{1}".format( key, KEY_STATES[ min( cur, 4 ) ] ) for key, ( prev, cur ) in enumerate( ctrl.scan_array() ) ) )
+		elif cmd == "press":
+			ctrl.key_events( [ ( code, 0x01 ) for code in args ] )
+		elif cmd == "release":
+			ctrl.key_events( [ ( code, 0x03 ) for code in args ] )
+		elif cmd == "layers":
+			states, stack = ctrl.layers()
+			for layer, state in enumerate( states ):
+				print( "L{0} {1:02X}".format( layer, state ) )
+			print( "Stack: {0}".format( stack ) )
+		elif cmd == "layer":
+			ctrl.set_layer( args[0], args[1] )
+		elif cmd == "usb":
+			print( "Coalesced Reports: {0}\nFree Packets: {1}".format( *ctrl.usb_counters() ) )
+		elif cmd == "bench":
+			count = args[0] if args else 1000
+			start = time.time()
+			for _ in range( count ):
+				ctrl.scan_array()
+			elapsed = time.time() - start
+			print( "{0} scan array reads in {1:.3f} s, {2:.3f} ms each".format( count, elapsed, elapsed / count * 1000 ) )
+		else:
+			print( __doc__ )
+			return 1
+
+	return 0
+
+if __name__ == '__main__':
+	sys.exit( main( sys.argv ) )
+
@@ -13,6 +13,7 @@
 
 set ( Module_SRCS
 	cli.c
+	control.c
 )
 
 
@@ -0,0 +1,12 @@
+#!/bin/bash
+# Builds and runs the host CLI tests
+# cli.c uses plain inline functions (gnu89 semantics on the firmware toolchain), hence -fgnu89-inline
+
+cd "$(dirname "$0")"
+BIN=$(mktemp)
+trap 'rm -f "$BIN"' EXIT
+
+gcc -std=gnu11 -fgnu89-inline -Os -Wall -Wno-builtin-declaration-mismatch -D_mk20dx256vlh7_ \
+	-Istub -I../../.. -I../../print -I../../led \
+	-o "$BIN" tabCompletion.c ../../print/print.c \
+	&& "$BIN"
@@ -0,0 +1,17 @@
+// Host test stand-in for the buildvars.h generated by CMake (Lib/_buildvars.h)
+#pragma once
+
+#define CLI_Revision       "test"
+#define CLI_Branch         "test"
+#define CLI_ModifiedStatus "test"
+#define CLI_ModifiedFiles  "test"
+#define CLI_RepoOrigin     "test"
+#define CLI_CommitDate     "test"
+#define CLI_CommitAuthor   "test"
+#define CLI_Modules        "test"
+#define CLI_BuildDate      "test"
+#define CLI_BuildOS        "test"
+#define CLI_Arch           "test"
+#define CLI_Chip           "test"
+#define CLI_CPU            "test"
+#define CLI_Device         "test"
@@ -0,0 +1,2 @@
+// Host test stand-in for the kll_defs.h generated by KLL
+#pragma once
@@ -0,0 +1,12 @@
+// Host test stand-in for the Output module interface used by the CLI
+#pragma once
+
+#include <stdint.h>
+
+#include <buildvars.h>
+
+int     Output_putstr( char* str );
+int     Output_getchar();
+uint8_t Output_availablechar();
+void    Output_softReset();
+void    Output_firmwareReload();
@@ -0,0 +1,181 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host test of CLI tab completion and command lookup over the sorted command index
+// Build and run with run.bash
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdio.h> // mk20dx.h declares the string.h functions with 32 bit sizes
+
+// CLI under test
+#include "../cli.c"
+
+
+
+// ----- Stubs -----
+
+int Output_putstr( char* str )
+{
+	return 0;
+}
+
+int Output_getchar()
+{
+	return 0;
+}
+
+uint8_t Output_availablechar()
+{
+	return 0;
+}
+
+void Output_softReset() {}
+void Output_firmwareReload() {}
+
+void init_errorLED() {}
+void errorLED( uint8_t on ) {}
+
+uint8_t Control_receiving()
+{
+	return 0;
+}
+
+void Control_receive( uint8_t byte ) {}
+
+
+
+// ----- Variables -----
+
+// Command names as registered by the modules of a typical build (the functions are never called)
+#define TestCmd(name) { #name, "", 0 }
+
+const CLIDictItem testLedDict[] = {
+	TestCmd( ledAnim ),
+	TestCmd( ledBright ),
+	TestCmd( ledPage ),
+	TestCmd( ledStart ),
+	TestCmd( ledStats ),
+	TestCmd( ledTest ),
+	TestCmd( ledZero ),
+	{ 0, 0, 0 }
+};
+
+const CLIDictItem testMacroDict[] = {
+	TestCmd( capList ),
+	TestCmd( capSelect ),
+	TestCmd( keyHold ),
+	TestCmd( keyPress ),
+	TestCmd( keyRelease ),
+	TestCmd( layerList ),
+	TestCmd( layerState ),
+	TestCmd( macroDebug ),
+	TestCmd( macroList ),
+	TestCmd( macroProc ),
+	TestCmd( macroShow ),
+	TestCmd( macroStep ),
+	{ 0, 0, 0 }
+};
+
+int failures = 0;
+
+
+
+// ----- Functions -----
+
+// Looks up the given command, expected is the command that would run (0 for none)
+void find( char* input, char* expected )
+{
+	uint8_t index = CLI_commandFind( input );
+	char* found = index < CLIIndexUsed ? CLI_indexName( index ) : 0;
+
+	if ( found != expected && ( !found || !expected || CLI_compareStr( found, expected ) != 0 ) )
+	{
+		printf( "FAIL: '%s' found '%s', expected '%s'\n", input, found ? found : "(none)", expected ? expected : "(none)" );
+		failures++;
+	}
+}
+
+// Completes the given input, and checks the line buffer afterwards
+void test( char* input, char* expected )
+{
+	CLILineBufferCurrent = 0;
+	while ( input[CLILineBufferCurrent] != '\0' )
+	{
+		CLILineBuffer[CLILineBufferCurrent] = input[CLILineBufferCurrent];
+		CLILineBufferCurrent++;
+	}
+
+	CLI_tabCompletion();
+	CLILineBuffer[CLILineBufferCurrent] = '\0';
+
+	if ( CLI_compareStr( CLILineBuffer, expected ) != 0 )
+	{
+		printf( "FAIL: '%s' completed to '%s', expected '%s'\n", input, CLILineBuffer, expected );
+		failures++;
+	}
+}
+
+int main()
+{
+	CLI_registerDictionary( basicCLIDict, basicCLIDictName );
+	CLI_registerDictionary( testLedDict, "LED" );
+	CLI_registerDictionary( testMacroDict, "Macro" );
+
+	// Unique prefixes
+	test( "ledT", "ledTest" );
+	test( "ve", "version" );
+	test( "lo", "logLevel" );
+	test( "capS", "capSelect" );
+
+	// Ambiguous prefixes are left alone
+	test( "mac", "mac" );
+	test( "ledS", "ledS" );
+	test( "re", "re" );
+
+	// Full matches are skipped, the led* commands left over are ambiguous so nothing is completed
+	test( "led", "led" );
+
+	// Unique, even though layerState starts the same way
+	test( "layerL", "layerList" );
+
+	// Nothing matches
+	test( "xyz", "xyz" );
+	test( "ledTestX", "ledTestX" );
+
+	// Exact matches win over longer commands
+	find( "led", "led" );
+	find( "ledTest", "ledTest" );
+
+	// Abbreviations of a single command
+	find( "ver", "version" );
+	find( "ledT", "ledTest" );
+	find( "layerS", "layerState" );
+
+	// Ambiguous or unknown
+	find( "ledS", 0 );
+	find( "mac", 0 );
+	find( "xyz", 0 );
+	find( "", 0 );
+
+	if ( failures )
+		return 1;
+
+	printf( "OK\n" );
+	return 0;
+}
+
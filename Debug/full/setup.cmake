@@ -15,6 +15,11 @@ AddModule ( Debug cli )
 AddModule ( Debug led )
 AddModule ( Debug print )
 
+# Binary trace records, ARM only
+if ( ${COMPILER_FAMILY} MATCHES "arm" )
+	AddModule ( Debug trace )
+endif ()
+
 
 ###
 # Compiler Family Compatibility
@@ -29,6 +29,13 @@
 
 
 
+// ----- Variables -----
+
+// Runtime log level, starts at the compile-time level
+uint8_t Print_logLevel = LogLevel_define;
+
+
+
 // ----- Functions -----
 
 // Multiple string Output
@@ -29,6 +29,7 @@
 #endif
 
 // Project Includes
+#include <kll_defs.h>
 #include <output_com.h>
 
 
@@ -36,6 +37,38 @@
 // ----- Defines -----
 #define NL "\r\n"
 
+// Log Levels
+#define LogLevel_None    0
+#define LogLevel_Error   1
+#define LogLevel_Warning 2
+#define LogLevel_Info    3
+#define LogLevel_Debug   4
+
+// Compile-time log level, see capabilities.kll
+#ifndef LogLevel_define
+#define LogLevel_define LogLevel_Debug
+#endif
+
+// Per module compile-time log level, defaults to LogLevel
+// To override, #undef and #define LogModuleLevel after the includes of the module source file
+#define LogModuleLevel LogLevel_define
+
+
+
+// ----- Macros -----
+
+// Whether log output at the given level should be shown
+// Levels above LogModuleLevel are constant 0, so the guarded code is removed at compile-time
+// Print_logLevel is the runtime level, set using the logLevel command
+// Use to guard multi-part log output, e.g. if ( log_enabled( LogLevel_Debug ) ) { dbug_msg("x: "); printHex( x ); }
+#define log_enabled( level ) ( (level) <= LogModuleLevel && (level) <= Print_logLevel )
+
+
+
+// ----- Variables -----
+
+extern uint8_t Print_logLevel; // Runtime log level, LogLevel_None to LogLevel_Debug
+
 
 
 // ----- Functions and Corresponding Function Aliases -----
@@ -75,9 +108,10 @@
 #define erro_msg(str)     printMsg         ("1;5;31", "ERROR",   str)         // Error Msg
 
 // Debug Messages
-#define dbug_dPrint(...)  dPrintMsg        ("1;35",   "DEBUG",   __VA_ARGS__) // Debug Msg
-#define dbug_print(str)   printMsgNL       ("1;35",   "DEBUG",   str)         // Debug Msg
-#define dbug_msg(str)     printMsg         ("1;35",   "DEBUG",   str)         // Debug Msg
+// Removed entirely when the module log level is below LogLevel_Debug
+#define dbug_dPrint(...)  do { if ( log_enabled( LogLevel_Debug ) ) dPrintMsg  ("1;35", "DEBUG", __VA_ARGS__); } while (0) // Debug Msg
+#define dbug_print(str)   do { if ( log_enabled( LogLevel_Debug ) ) printMsgNL ("1;35", "DEBUG", str);         } while (0) // Debug Msg
+#define dbug_msg(str)     do { if ( log_enabled( LogLevel_Debug ) ) printMsg   ("1;35", "DEBUG", str);         } while (0) // Debug Msg
 
 
 // Static String Printing
@@ -0,0 +1,200 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/OutputLib.h>
+
+// Project Includes
+#include <cli.h>
+#include <kll_defs.h>
+#include <print.h>
+
+// Local Includes
+#include "trace.h"
+
+
+
+// ----- Defines -----
+
+#define Trace_bufferSize TraceBufferSize_define
+#define Trace_bufferMask ( Trace_bufferSize - 1 )
+
+#if ( Trace_bufferSize & Trace_bufferMask ) != 0
+#error "TraceBufferSize must be a power of two"
+#endif
+
+// Marks the start of a binary record in the debug output (ASCII RS)
+// Text output never contains it, and it differs from the control protocol frame start (STX)
+// Each record ends with a checksum byte, so a start byte inside binary data (e.g. a control response)
+// is rejected by traceDecode.py, which then resyncs on the next one
+#define Trace_frameStart 0x1E
+
+
+
+// ----- Function Declarations -----
+
+void cliFunc_traceEnable( char* args );
+void cliFunc_traceStatus( char* args );
+
+
+
+// ----- Variables -----
+
+// Trace Module command dictionary
+CLIDict_Entry( traceEnable, "Enable/Disable binary trace records. Decode the output with traceDecode.py." NL "\t\tArg: Mask of groups, 1 - General, 2 - UARTConnect (default toggles all)." );
+CLIDict_Entry( traceStatus, "Show trace buffer usage and dropped records." );
+
+CLIDict_Def( traceCLIDict, "Trace Module Commands" ) = {
+	CLIDict_Item( traceEnable ),
+	CLIDict_Item( traceStatus ),
+	{ 0, 0, 0 } // Null entry for dictionary end
+};
+
+// Record ring, each record is a header word followed by its arguments
+//  Header: [31:16] Format id, [15:14] Argument count, [13:0] Timestamp (ms)
+static uint32_t Trace_buffer[ Trace_bufferSize ];
+
+// Free running positions, only the low bits index the buffer
+static volatile uint32_t Trace_head = 0; // Written by Trace_record
+static volatile uint32_t Trace_tail = 0; // Written by Trace_process
+
+volatile uint8_t  Trace_enabled = 0;
+volatile uint32_t Trace_dropped = 0;
+
+// System Timer, used to timestamp records
+extern volatile uint32_t systick_millis_count;
+
+
+
+// ----- Functions -----
+
+inline void Trace_setup()
+{
+	// Register Trace CLI dictionary
+	CLI_registerDictionary( traceCLIDict, traceCLIDictName );
+}
+
+
+// Append a record to the ring, safe to call from interrupts
+// Only stores raw values, all formatting is done on the host
+// Called through the trace macros, which have already checked that the group is enabled
+void Trace_record( uint16_t id, uint8_t argc, uint32_t arg1, uint32_t arg2, uint32_t arg3 )
+{
+	uint32_t primask;
+	uint32_t pos;
+
+	// Save and restore the interrupt mask, so this works with interrupts already disabled
+	__asm__ volatile ( "mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory" );
+
+	pos = Trace_head;
+	if ( pos - Trace_tail + argc + 1 > Trace_bufferSize )
+	{
+		Trace_dropped++;
+		__asm__ volatile ( "msr primask, %0" :: "r" (primask) : "memory" );
+		return;
+	}
+
+	Trace_buffer[ pos++ & Trace_bufferMask ] = ( (uint32_t)id << 16 ) | ( (uint32_t)argc << 14 ) | ( systick_millis_count & 0x3FFF );
+	if ( argc > 0 )
+		Trace_buffer[ pos++ & Trace_bufferMask ] = arg1;
+	if ( argc > 1 )
+		Trace_buffer[ pos++ & Trace_bufferMask ] = arg2;
+	if ( argc > 2 )
+		Trace_buffer[ pos++ & Trace_bufferMask ] = arg3;
+	Trace_head = pos;
+
+	__asm__ volatile ( "msr primask, %0" :: "r" (primask) : "memory" );
+}
+
+
+// Send buffered records over the debug output, called from the main loop
+// Each record is sent as the frame start, its words (little endian) and a checksum
+// The checksum makes the 8 bit sum of every byte after the frame start zero (same as control frames)
+void Trace_process()
+{
+	uint32_t word;
+	uint8_t argc;
+	uint8_t sum;
+
+	for ( uint8_t records = 0; records < TraceDrainLimit_define && Trace_tail != Trace_head; records++ )
+	{
+		argc = ( Trace_buffer[ Trace_tail & Trace_bufferMask ] >> 14 ) & 0x3;
+
+		Output_putchar( Trace_frameStart );
+		sum = 0;
+		for ( uint8_t pos = 0; pos <= argc; pos++ )
+		{
+			word = Trace_buffer[ ( Trace_tail + pos ) & Trace_bufferMask ];
+			for ( uint8_t byte = 0; byte < 4; byte++, word >>= 8 )
+			{
+				sum += (uint8_t)word;
+				Output_putchar( (char)word );
+			}
+		}
+		Output_putchar( (char)( -sum ) );
+
+		// Only free the space once the record has been sent
+		Trace_tail += argc + 1;
+	}
+}
+
+
+
+// ----- CLI Command Functions -----
+
+void cliFunc_traceEnable( char* args )
+{
+	// Parse number from argument
+	//  NOTE: Only first argument is used
+	char* arg1Ptr;
+	char* arg2Ptr;
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+
+	// Toggle every group if no argument is given, otherwise the argument is the mask of groups
+	if ( arg1Ptr[0] == '\0' )
+	{
+		Trace_enabled = Trace_enabled ? 0 : TraceGroup_All;
+	}
+	else
+	{
+		Trace_enabled = numToInt( arg1Ptr );
+	}
+
+	print( NL );
+	info_msg("Trace Groups: ");
+	printHex( Trace_enabled );
+}
+
+
+void cliFunc_traceStatus( char* args )
+{
+	print( NL );
+	info_msg("Buffered Words: ");
+	printInt32( Trace_head - Trace_tail );
+	print("/");
+	printInt32( Trace_bufferSize );
+	print( NL );
+	info_msg("Dropped Records: ");
+	printInt32( Trace_dropped );
+}
+
@@ -0,0 +1,80 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdint.h>
+
+
+
+// ----- Enums -----
+
+// Trace groups, each bit of Trace_enabled turns on the records of one group (traceEnable)
+typedef enum TraceGroup {
+	TraceGroup_General = 0x01, // trace0..trace3
+	TraceGroup_Connect = 0x02, // UARTConnect link events
+	TraceGroup_All     = 0xFF,
+} TraceGroup;
+
+
+
+// ----- Macros -----
+
+// Trace format strings are never loaded onto the device
+// They are placed in the non-allocated .trace_fmt section of the ELF, the record id is the offset of the string
+// At build time the section is dumped to <target>.trace, which traceDecode.py uses to expand records to text
+#define trace_id( fmt ) ({ \
+		static const char trace_fmt_str[] __attribute__ ((section(".trace_fmt"), used, aligned(1))) = fmt; \
+		(uint16_t)(uintptr_t)trace_fmt_str; \
+	})
+
+// Record an event, fmt must be a string literal using printf style (%d, %u, %x, %02x, %c) conversions
+// All arguments are recorded as raw 32 bit values
+// The group is checked before the arguments are evaluated, a disabled group only costs a load and a branch
+#define traceGroup0( group, fmt )          ( ( Trace_enabled & (group) ) ? Trace_record( trace_id( fmt ), 0, 0, 0, 0 ) : (void)0 )
+#define traceGroup1( group, fmt, a )       ( ( Trace_enabled & (group) ) ? Trace_record( trace_id( fmt ), 1, (uint32_t)(a), 0, 0 ) : (void)0 )
+#define traceGroup2( group, fmt, a, b )    ( ( Trace_enabled & (group) ) ? Trace_record( trace_id( fmt ), 2, (uint32_t)(a), (uint32_t)(b), 0 ) : (void)0 )
+#define traceGroup3( group, fmt, a, b, c ) ( ( Trace_enabled & (group) ) ? Trace_record( trace_id( fmt ), 3, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c) ) : (void)0 )
+
+#define trace0( fmt )             traceGroup0( TraceGroup_General, fmt )
+#define trace1( fmt, a )          traceGroup1( TraceGroup_General, fmt, a )
+#define trace2( fmt, a, b )       traceGroup2( TraceGroup_General, fmt, a, b )
+#define trace3( fmt, a, b, c )    traceGroup3( TraceGroup_General, fmt, a, b, c )
+
+
+
+// ----- Variables -----
+
+extern volatile uint8_t  Trace_enabled; // Mask of TraceGroup, records of disabled groups are discarded
+extern volatile uint32_t Trace_dropped; // Records lost due to a full buffer
+
+
+
+// ----- Functions -----
+
+void Trace_setup();
+void Trace_process();
+
+void Trace_record( uint16_t id, uint8_t argc, uint32_t arg1, uint32_t arg2, uint32_t arg3 );
+
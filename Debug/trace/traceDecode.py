@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+'''
+Expands binary trace records (see trace.c) from a debug output capture back into text
+
+Usage:
+  traceDecode.py <target>.trace [capture file or serial device]
+
+<target>.trace is generated at build time from the .trace_fmt section of the ELF.
+Anything in the capture that isn't a trace record is passed through unchanged, except binary
+control protocol frames (see Debug/cli/control.py), which are skipped.
+If no capture is given, stdin is used.
+'''
+
+# Copyright (C) 2015 by Jacob Alexander
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+# Imports
+import struct
+import sys
+
+
+# Must match trace.c
+FRAME_START = 0x1E
+TIMESTAMP_WRAP = 0x4000
+
+# Must match control.h, responses share the debug output with trace records and text
+CONTROL_FRAME_START = 0x02
+CONTROL_HEADER = 4 # STX, id, length (16 bit)
+
+# Longest control response waited for, a stray STX with a larger length is treated as text
+CONTROL_MAX_LENGTH = 4096
+
+
+# Format table, format string id (offset into the table) -> format string
+class TraceFormats:
+	def __init__( self, table_file ):
+		with open( table_file, 'rb' ) as f:
+			self.table = f.read()
+
+	def lookup( self, fmt_id ):
+		if fmt_id >= len( self.table ):
+			return None
+		end = self.table.find( b'\0', fmt_id )
+		return self.table[fmt_id:end].decode( 'utf-8', 'replace' )
+
+
+# Stream decoder, keeps state between reads so records may be split across reads
+class TraceDecoder:
+	def __init__( self, formats, out ):
+		self.formats = formats
+		self.out = out
+		self.pending = bytearray()
+
+		# Timestamp unwrapping
+		self.last_stamp = None
+		self.time = 0
+
+	def timestamp( self, stamp ):
+		if self.last_stamp is not None:
+			self.time += ( stamp - self.last_stamp ) % TIMESTAMP_WRAP
+		else:
+			self.time = stamp
+		self.last_stamp = stamp
+		return self.time
+
+	def record( self, header, args ):
+		fmt_id = header >> 16
+		fmt = self.formats.lookup( fmt_id )
+		time = self.timestamp( header & 0x3FFF )
+
+		if fmt is None:
+			text = "<unknown trace id 0x{0:04x}> {1}".format( fmt_id, " ".join( hex( arg ) for arg in args ) )
+		else:
+			try:
+				text = fmt % tuple( args )
+			except ( TypeError, ValueError ):
+				text = "{0} {1}".format( fmt, args )
+
+		self.out.write( "\033[1;36mTRACE\033[0m {0:>8} ms - {1}\r\n".format( time, text ) )
+
+	# Length of the frame at the start of pending, 0 if more data is needed, None if it isn't a frame
+	# A frame is only accepted once its checksum (8 bit sum of every byte after the start is zero) matches
+	def frame_length( self ):
+		start = self.pending[0]
+
+		if start == FRAME_START:
+			if len( self.pending ) < 5:
+				return 0
+			argc = ( self.pending[2] >> 6 ) & 0x3 # Header bits [15:14]
+			length = 5 + argc * 4 + 1
+		else:
+			if len( self.pending ) < CONTROL_HEADER:
+				return 0
+			data_len = self.pending[2] | self.pending[3] << 8
+			if data_len > CONTROL_MAX_LENGTH:
+				return None
+			length = CONTROL_HEADER + data_len + 2 # Status and checksum
+
+		if len( self.pending ) < length:
+			return 0
+		if sum( self.pending[1:length] ) & 0xFF != 0:
+			return None
+
+		return length
+
+	def feed( self, data ):
+		self.pending.extend( data )
+
+		while self.pending:
+			# Next byte that may start a trace record or a control frame
+			starts = [ pos for pos in ( self.pending.find( FRAME_START ), self.pending.find( CONTROL_FRAME_START ) ) if pos >= 0 ]
+			start = min( starts ) if starts else -1
+
+			# Plain text
+			if start != 0:
+				text = self.pending if start < 0 else self.pending[:start]
+				self.out.write( text.decode( 'utf-8', 'replace' ) )
+				del self.pending[:len( text )]
+				continue
+
+			length = self.frame_length()
+			if length == 0:
+				break
+
+			# Not a valid frame, drop the start byte and resync on the next one
+			if length is None:
+				del self.pending[:1]
+				continue
+
+			# Control responses are for control.py, skip them whole so their data isn't mistaken for records
+			if self.pending[0] == CONTROL_FRAME_START:
+				del self.pending[:length]
+				continue
+
+			header, = struct.unpack_from( '<I', self.pending, 1 )
+			argc = ( header >> 14 ) & 0x3
+			args = struct.unpack_from( '<{0}I'.format( argc ), self.pending, 5 )
+			del self.pending[:length]
+			self.record( header, args )
+
+		self.out.flush()
+
+	# End of the capture, a partial frame can't be completed anymore
+	def finish( self ):
+		self.out.write( self.pending.decode( 'utf-8', 'replace' ) )
+		del self.pending[:]
+		self.out.flush()
+
+
+# Main
+if __name__ == '__main__':
+	if len( sys.argv ) < 2:
+		print( __doc__ )
+		sys.exit( 1 )
+
+	formats = TraceFormats( sys.argv[1] )
+	decoder = TraceDecoder( formats, sys.stdout )
+
+	capture = open( sys.argv[2], 'rb', buffering=0 ) if len( sys.argv ) > 2 else sys.stdin.buffer
+	while True:
+		data = capture.read( 1024 )
+		if not data:
+			break
+		decoder.feed( data )
+	decoder.finish()
+
@@ -94,6 +94,17 @@ add_custom_command( TARGET ${TARGET_ELF} POST_BUILD
 )
 
 
+#| Dump the Trace Format Table .TRACE (used by Debug/trace/traceDecode.py)
+#| Only present if the trace module is used, ARM only
+if ( "${COMPILER_FAMILY}" MATCHES "arm" AND "${Debug_SRCS}" MATCHES "trace.c" )
+	set( TARGET_TRACE ${TARGET}.trace )
+	add_custom_command( TARGET ${TARGET_ELF} POST_BUILD
+		COMMAND ${OBJ_COPY} -O binary --only-section=.trace_fmt --set-section-flags .trace_fmt=alloc,load,contents ${TARGET_ELF} ${TARGET_TRACE}
+		COMMENT "Creating Trace Format Table:   ${TARGET_TRACE}"
+	)
+endif ()
+
+
 #| Compiler Selection Record
 add_custom_command( TARGET ${TARGET_ELF} POST_BUILD
 	COMMAND ${CMAKE_SOURCE_DIR}/Lib/CMake/writer compiler ${COMPILER_FAMILY}
@@ -0,0 +1,172 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Host stress test for the single producer, single consumer ring buffer (Lib/ringbuf.h)
+// A producer thread (standing in for the main loop) and a consumer thread (standing in for an ISR or DMA)
+// run concurrently on a small buffer, the consumer checks that the byte sequence arrives intact.
+// Both sides yield when the buffer is full/empty, so the test also makes progress on single core hosts.
+// The consumer alternates between RingBuf_pop and RingBuf_peek/RingBuf_consume (DMA style).
+//
+// Build (from this directory):
+//   cc -O2 -pthread -I../.. -o ringbuf_stress ringbuf_stress.c
+//
+// Usage:
+//   ./ringbuf_stress [megabytes]
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Project Includes
+#include <Lib/ringbuf.h>
+
+
+
+// ----- Variables -----
+
+RingBuf_define( stress, 16 );
+
+uint32_t total;
+volatile uint32_t errors = 0;
+
+
+
+// ----- Functions -----
+
+// Small xorshift, varies the chunk sizes on both sides
+static uint32_t next( uint32_t *state )
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+void *producer( void *arg )
+{
+	uint32_t random = 1;
+	uint32_t sent = 0;
+	uint8_t chunk[16];
+
+	while ( sent < total )
+	{
+		// Single bytes, or all-or-nothing chunks
+		uint16_t len = next( &random ) % 12 + 1;
+		if ( len > total - sent )
+			len = total - sent;
+
+		for ( uint16_t c = 0; c < len; c++ )
+			chunk[c] = (uint8_t)( sent + c );
+
+		if ( len == 1 )
+		{
+			if ( RingBuf_push( &stress, chunk[0] ) )
+				sent++;
+			else
+				sched_yield();
+		}
+		else if ( RingBuf_write( &stress, chunk, len ) )
+		{
+			sent += len;
+		}
+		// Full, let the consumer run (matters on single core hosts)
+		else
+		{
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+void *consumer( void *arg )
+{
+	uint32_t random = 7;
+	uint32_t received = 0;
+
+	while ( received < total )
+	{
+		uint8_t byte;
+		uint8_t *data;
+
+		if ( next( &random ) & 1 )
+		{
+			if ( !RingBuf_pop( &stress, &byte ) )
+			{
+				sched_yield();
+				continue;
+			}
+
+			if ( byte != (uint8_t)received )
+				errors++;
+			received++;
+		}
+		else
+		{
+			uint16_t len = RingBuf_peek( &stress, &data );
+			if ( len == 0 )
+			{
+				sched_yield();
+				continue;
+			}
+
+			// Partial consumes, like a DMA transfer that is split up
+			len = next( &random ) % len + 1;
+			for ( uint16_t c = 0; c < len; c++ )
+			{
+				if ( data[c] != (uint8_t)( received + c ) )
+					errors++;
+			}
+			RingBuf_consume( &stress, len );
+			received += len;
+		}
+	}
+
+	return NULL;
+}
+
+int main( int argc, char **argv )
+{
+	total = ( argc > 1 ? atoi( argv[1] ) : 64 ) * 1024 * 1024;
+
+	struct timespec start, end;
+	clock_gettime( CLOCK_MONOTONIC, &start );
+
+	pthread_t producerThread, consumerThread;
+	pthread_create( &consumerThread, NULL, consumer, NULL );
+	pthread_create( &producerThread, NULL, producer, NULL );
+	pthread_join( producerThread, NULL );
+	pthread_join( consumerThread, NULL );
+
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	double seconds = ( end.tv_sec - start.tv_sec ) + ( end.tv_nsec - start.tv_nsec ) / 1e9;
+
+	printf( "%u bytes in %.3f s (%.1f MB/s), %u errors, %u left\n",
+		total, seconds, total / seconds / 1e6, errors, RingBuf_items( &stress ) );
+
+	return errors != 0 || RingBuf_items( &stress ) != 0;
+}
+
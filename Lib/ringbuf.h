@@ -0,0 +1,150 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+#include <stdint.h>
+
+
+
+// ----- Macros -----
+
+// Single producer, single consumer ring buffer
+// One side may be an ISR (or DMA), the other the main loop, without disabling interrupts
+//  - head is only written by the consumer, tail only by the producer
+//  - Both are free running 16 bit counters, the size must be a power of two (at most 32768)
+//    so the buffer can be completely filled, and items is always tail - head
+//
+// Declares the storage and the ring buffer, e.g.
+//  RingBuf_define( uart0_tx, 128 );
+//  RingBuf_push( &uart0_tx, byte );
+#define RingBuf_define( name, size ) \
+	_Static_assert( (size) > 0 && ( (size) & ( (size) - 1 ) ) == 0 && (size) <= 0x8000, #name " size must be a power of two" ); \
+	uint8_t name##_data[ size ]; \
+	RingBuf name = { 0, 0, (size) - 1, name##_data }
+
+// Orders the buffer memory accesses against the index updates (dmb on ARM)
+// Also needed before a DMA transfer reads data that was just written
+#define RingBuf_barrier() __sync_synchronize()
+
+
+
+// ----- Structs -----
+
+typedef struct RingBuf {
+	volatile uint16_t head; // Next read position, only written by the consumer
+	volatile uint16_t tail; // Next write position, only written by the producer
+	uint16_t          mask; // Size - 1
+	uint8_t          *data;
+} RingBuf;
+
+
+
+// ----- Functions -----
+
+// Number of bytes waiting to be read
+static inline uint16_t RingBuf_items( RingBuf *ring )
+{
+	return (uint16_t)( ring->tail - ring->head );
+}
+
+// Number of bytes that can be written
+static inline uint16_t RingBuf_space( RingBuf *ring )
+{
+	return ring->mask + 1 - RingBuf_items( ring );
+}
+
+// Resets the ring buffer, neither side may be using it
+static inline void RingBuf_reset( RingBuf *ring )
+{
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+
+// -- Producer --
+
+// Adds a byte, returns 0 if the buffer is full
+static inline uint8_t RingBuf_push( RingBuf *ring, uint8_t byte )
+{
+	uint16_t tail = ring->tail;
+	if ( (uint16_t)( tail - ring->head ) > ring->mask )
+		return 0;
+
+	ring->data[ tail & ring->mask ] = byte;
+	RingBuf_barrier();
+	ring->tail = tail + 1;
+	return 1;
+}
+
+// Adds all of the bytes or none of them, returns 0 if there isn't enough space
+static inline uint8_t RingBuf_write( RingBuf *ring, const uint8_t *data, uint16_t len )
+{
+	uint16_t tail = ring->tail;
+	if ( (uint16_t)( ring->mask + 1 - ( tail - ring->head ) ) < len )
+		return 0;
+
+	for ( uint16_t pos = 0; pos < len; pos++ )
+		ring->data[ ( tail + pos ) & ring->mask ] = data[ pos ];
+	RingBuf_barrier();
+	ring->tail = tail + len;
+	return 1;
+}
+
+
+// -- Consumer --
+
+// Removes a byte, returns 0 if the buffer is empty
+static inline uint8_t RingBuf_pop( RingBuf *ring, uint8_t *byte )
+{
+	uint16_t head = ring->head;
+	if ( ring->tail == head )
+		return 0;
+
+	RingBuf_barrier();
+	*byte = ring->data[ head & ring->mask ];
+	RingBuf_barrier();
+	ring->head = head + 1;
+	return 1;
+}
+
+// Contiguous readable bytes starting at the head (stops at the end of the storage)
+// Used to hand the data directly to a DMA transfer, followed by RingBuf_consume
+static inline uint16_t RingBuf_peek( RingBuf *ring, uint8_t **data )
+{
+	uint16_t head = ring->head;
+	uint16_t items = (uint16_t)( ring->tail - head );
+	uint16_t toEnd = ring->mask + 1 - ( head & ring->mask );
+
+	RingBuf_barrier();
+	*data = &ring->data[ head & ring->mask ];
+	return items < toEnd ? items : toEnd;
+}
+
+// Frees bytes that have been read through RingBuf_peek
+static inline void RingBuf_consume( RingBuf *ring, uint16_t len )
+{
+	RingBuf_barrier();
+	ring->head += len;
+}
+
@@ -21,6 +21,7 @@
 
 // Project Includes
 #include <cli.h>
+#include <control.h>
 #include <led.h>
 #include <print.h>
 #include <scan_loop.h>
@@ -34,6 +35,14 @@
 
 
 
+// ----- Defines -----
+
+// Macro module log level
+#undef  LogModuleLevel
+#define LogModuleLevel MacroLogLevel_define
+
+
+
 // ----- Function Declarations -----
 
 void cliFunc_capList   ( char* args );
@@ -50,6 +59,10 @@ void cliFunc_macroProc ( char* args );
 void cliFunc_macroShow ( char* args );
 void cliFunc_macroStep ( char* args );
 
+uint8_t Macro_controlKeyEvent  ( uint8_t* data, uint8_t len );
+uint8_t Macro_controlLayerRead ( uint8_t* data, uint8_t len );
+uint8_t Macro_controlLayerWrite( uint8_t* data, uint8_t len );
+
 
 
 // ----- Enums -----
@@ -113,6 +126,14 @@ CLIDict_Def( macroCLIDict, "Macro Module Commands" ) = {
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
+// Macro Module control requests
+const ControlItem macroControlDict[] = {
+	{ ControlId_KeyEvent,   Macro_controlKeyEvent },
+	{ ControlId_LayerRead,  Macro_controlLayerRead },
+	{ ControlId_LayerWrite, Macro_controlLayerWrite },
+	{ 0, 0 } // Null entry for dictionary end
+};
+
 
 // Layer debug flag - If set, displays any changes to layers and the full layer stack on change
 uint8_t layerDebugMode = 0;
@@ -146,6 +167,9 @@ uint16_t macroTriggerMacroPendingListSize = 0;
 uint16_t macroLayerIndexStack[ LayerNum + 1 ] = { 0 };
 uint16_t macroLayerIndexStackSize = 0;
 
+// Layer change notification (see macro.h)
+void (*Macro_layerNotify)( void ) = 0;
+
 // Pending Result Macro Index List
 //  * Any result macro that needs processing from a previous macro processing loop
 uint16_t macroResultMacroPendingList[ ResultMacroNum ] = { 0 };
@@ -212,7 +236,7 @@ void Macro_layerState( uint8_t state, uint8_t stateType, uint16_t layer, uint8_t
 	}
 
 	// Layer Debug Mode
-	if ( layerDebugMode )
+	if ( log_enabled( LogLevel_Debug ) && layerDebugMode )
 	{
 		dbug_msg("Layer ");
 
@@ -234,6 +258,10 @@ void Macro_layerState( uint8_t state, uint8_t stateType, uint16_t layer, uint8_t
 
 		print( NL );
 	}
+
+	// Layer change subscriber (e.g. status display)
+	if ( Macro_layerNotify )
+		Macro_layerNotify();
 }
 
 // Modifies the specified Layer control byte
@@ -341,6 +369,15 @@ void Macro_layerShift_capability( uint8_t state, uint8_t stateType, uint8_t *arg
 
 // ----- Functions -----
 
+// Name of the given layer, for display purposes
+const char *Macro_layerName( uint16_t layer )
+{
+	if ( layer >= LayerNum || !LayerIndex[ layer ].name )
+		return "";
+
+	return LayerIndex[ layer ].name;
+}
+
 // Looks up the trigger list for the given scan code (from the active layer)
 // NOTE: Calling function must handle the NULL pointer case
 nat_ptr_t *Macro_layerLookup( TriggerGuide *guide, uint8_t latch_expire )
@@ -1035,6 +1072,7 @@ inline void Macro_setup()
 {
 	// Register Macro CLI dictionary
 	CLI_registerDictionary( macroCLIDict, macroCLIDictName );
+	Control_registerDictionary( macroControlDict );
 
 	// Disable Macro debug mode
 	macroDebugMode = 0;
@@ -1317,6 +1355,8 @@ void cliFunc_layerState( char* args )
 
 			// Set the layer state
 			LayerState[ arg1 ] = arg2;
+			if ( Macro_layerNotify )
+				Macro_layerNotify();
 			break;
 		}
 	}
@@ -1608,3 +1648,62 @@ void cliFunc_macroStep( char* args )
 	macroStepCounter = count;
 }
 
+
+
+// ----- Control Request Functions -----
+
+uint8_t Macro_controlKeyEvent( uint8_t* data, uint8_t len )
+{
+	// <scancode> <state> pairs
+	if ( len % 2 != 0 )
+		return ControlStatus_BadArgs;
+
+	for ( uint8_t pos = 0; pos < len; pos += 2 )
+	{
+		Macro_keyState( data[ pos ], data[ pos + 1 ] );
+	}
+
+	return ControlStatus_Ok;
+}
+
+uint8_t Macro_controlLayerRead( uint8_t* data, uint8_t len )
+{
+	uint16_t layerNum = LayerNum;
+
+	// <count u16> <LayerState[count]> <stack size u16> <stack u16[size]>
+	Control_replyBegin( 2 + layerNum + 2 + macroLayerIndexStackSize * 2 );
+
+	Control_write( (uint8_t*)&layerNum, 2 );
+	Control_write( (uint8_t*)LayerState, layerNum );
+	Control_write( (uint8_t*)&macroLayerIndexStackSize, 2 );
+	Control_write( (uint8_t*)macroLayerIndexStack, macroLayerIndexStackSize * 2 );
+
+	return ControlStatus_Ok;
+}
+
+uint8_t Macro_controlLayerWrite( uint8_t* data, uint8_t len )
+{
+	// <layer u16> <state> triples
+	if ( len % 3 != 0 )
+		return ControlStatus_BadArgs;
+
+	for ( uint8_t pos = 0; pos < len; pos += 3 )
+	{
+		uint16_t layer = data[ pos ] | data[ pos + 1 ] << 8;
+		uint8_t state = data[ pos + 2 ];
+
+		if ( layer >= LayerNum )
+			return ControlStatus_BadArgs;
+
+		// Macro_layerState toggles the given bits, clear and set separately so the layer stack stays consistent
+		uint8_t clear = LayerState[ layer ] & ~state;
+		uint8_t set   = state & ~LayerState[ layer ];
+		if ( clear )
+			Macro_layerState( 0, 0, layer, clear );
+		if ( set )
+			Macro_layerState( 0, 0, layer, set );
+	}
+
+	return ControlStatus_Ok;
+}
+
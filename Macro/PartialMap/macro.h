@@ -23,6 +23,18 @@
 
 
 
+// ----- Variables -----
+
+// Layer stack, the most recently activated layer is last (the default layer, 0, is never on the stack)
+extern uint16_t macroLayerIndexStack[];
+extern uint16_t macroLayerIndexStackSize;
+
+// Called after every layer state change, e.g. to refresh a status display
+// Several changes may happen per macro processing loop, so it should only flag the change
+extern void (*Macro_layerNotify)( void );
+
+
+
 // ----- Capabilities -----
 
 void Macro_layerState_capability( uint8_t state, uint8_t stateType, uint8_t *args );
@@ -35,6 +47,7 @@ void Macro_layerShift_capability( uint8_t state, uint8_t stateType, uint8_t *arg
 // ----- Functions -----
 
 void Macro_analogState( uint8_t scanCode, uint8_t state );
+const char *Macro_layerName( uint16_t layer );
 void Macro_keyState( uint8_t scanCode, uint8_t state );
 void Macro_ledState( uint8_t ledCode, uint8_t state );
 void Macro_triggerState( void *triggers, uint8_t num ); // triggers is of type TriggerGuide, void* for circular dependencies
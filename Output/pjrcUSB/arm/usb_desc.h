@@ -62,11 +62,13 @@
 #define KEYBOARD_ENDPOINT       1
 #define KEYBOARD_SIZE           8
 #define KEYBOARD_INTERVAL       1
+#define KEYBOARD_RESERVED_BUFFERS 1 // Packets only this endpoint may use
 
 #define NKRO_KEYBOARD_INTERFACE 1 // NKRO Keyboard
 #define NKRO_KEYBOARD_ENDPOINT  2
 #define NKRO_KEYBOARD_SIZE      64
 #define NKRO_KEYBOARD_INTERVAL  1
+#define NKRO_KEYBOARD_RESERVED_BUFFERS 1 // Packets only this endpoint may use
 
 #define CDC_IAD_DESCRIPTOR      1
 #define CDC_STATUS_INTERFACE    2
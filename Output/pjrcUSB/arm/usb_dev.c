@@ -905,6 +905,8 @@ restart:
 					usb_serial_flush_callback();
 			}
 
+			// Keyboard Interfaces, send any coalesced report
+			usb_keyboard_flush_callback();
 		}
 		USB0_ISTAT = USB_INTEN_SOFTOKEN;
 	}
@@ -985,6 +987,10 @@ restart:
 						break;
 					}
 				}
+
+				// Keyboard endpoint has a free slot, send any coalesced report
+				if ( endpoint + 1 == KEYBOARD_ENDPOINT || endpoint + 1 == NKRO_KEYBOARD_ENDPOINT )
+					usb_keyboard_flush_callback();
 			}
 			else
 			{ // receive
@@ -83,4 +83,5 @@ static inline uint32_t usb_rx_byte_count(uint32_t endpoint)
 void usb_device_reload();
 
 extern void usb_serial_flush_callback();
+extern void usb_keyboard_flush_callback();
 
@@ -49,81 +49,175 @@
 // Maximum number of transmit packets to queue so we don't starve other endpoints for memory
 #define TX_PACKET_LIMIT 4
 
-// When the PC isn't listening, how long do we wait before discarding data?
-#define TX_TIMEOUT_MSEC 50
 
-#if F_CPU == 96000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 596)
-#elif F_CPU == 72000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 512) // XXX Correct?
-#elif F_CPU == 48000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 428)
-#elif F_CPU == 24000000
-	#define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
-#endif
 
+// ----- Variables -----
 
+// Snapshot of the latest report state, waiting to be sent to the host
+// Changes that arrive before the snapshot is sent are merged into it (coalesced)
+// Only the flush path and usb_keyboard_send may touch these
+static volatile uint8_t usb_keyboard_pending = USBKeyChangeState_None;
+static          uint8_t usb_keyboard_busy    = 0;
 
-// ----- Variables -----
+static uint8_t  pending_protocol;
+static uint8_t  pending_modifiers;
+static uint8_t  pending_keys[USB_NKRO_BITFIELD_SIZE_KEYS];
+static uint8_t  pending_sysctrl;
+static uint16_t pending_consctrl;
 
-static uint8_t transmit_previous_timeout = 0;
+// Number of reports merged into a pending report before it could be sent
+volatile uint32_t usb_keyboard_coalesced = 0;
 
 
 
 // ----- Functions -----
 
-// send the contents of keyboard_keys and keyboard_modifier_keys
-void usb_keyboard_send()
+// Allocate a packet for the given keyboard endpoint, never waits
+// Falls back on the packets reserved for the endpoint when the general pool is empty (e.g. CDC output)
+static usb_packet_t *usb_keyboard_malloc( uint32_t endpoint )
+{
+	if ( usb_tx_packet_count( endpoint ) >= TX_PACKET_LIMIT )
+		return NULL;
+
+	return usb_malloc_endpoint( endpoint );
+}
+
+
+// Send as much of the pending report as there are free packets
+// Called from both the main loop and the USB ISR (SOF and TX complete)
+static void usb_keyboard_flush()
 {
-	uint32_t wait_count = 0;
 	usb_packet_t *tx_packet;
+	uint8_t *tx_buf;
 
-	// Wait till ready
-	while ( 1 )
+	// Only one context may build packets at a time
+	// If the main loop is already flushing, the ISR will retry next SOF
+	__disable_irq();
+	if ( usb_keyboard_busy || !usb_keyboard_pending )
 	{
-		if ( !usb_configuration )
-		{
-			erro_print("USB not configured...");
-			return;
-		}
+		__enable_irq();
+		return;
+	}
+	usb_keyboard_busy = 1;
+	__enable_irq();
+
+	switch ( pending_protocol )
+	{
+	// Send boot keyboard interrupt packet(s)
+	case 0:
+		tx_packet = usb_keyboard_malloc( KEYBOARD_ENDPOINT );
+		if ( !tx_packet )
+			break;
+		tx_buf = tx_packet->buf;
 
-		if ( USBKeys_Protocol == 0 ) // Boot Mode
+		// Boot Mode
+		*tx_buf++ = pending_modifiers;
+		*tx_buf++ = 0;
+		memcpy( tx_buf, pending_keys, USB_BOOT_MAX_KEYS );
+		tx_packet->len = 8;
+
+		// Send USB Packet
+		usb_tx( KEYBOARD_ENDPOINT, tx_packet );
+		usb_keyboard_pending = USBKeyChangeState_None;
+		break;
+
+	// Send NKRO keyboard interrupts packet(s)
+	// Each report gets its own packet, anything left over stays pending
+	case 1:
+		// Check system control keys
+		if ( usb_keyboard_pending & USBKeyChangeState_System )
 		{
-			if ( usb_tx_packet_count( NKRO_KEYBOARD_ENDPOINT ) < TX_PACKET_LIMIT )
-			{
-				tx_packet = usb_malloc();
-				if ( tx_packet )
-					break;
-			}
+			tx_packet = usb_keyboard_malloc( NKRO_KEYBOARD_ENDPOINT );
+			if ( !tx_packet )
+				break;
+			tx_buf = tx_packet->buf;
+
+			*tx_buf++ = 0x02; // ID
+			*tx_buf   = pending_sysctrl;
+			tx_packet->len = 2;
+
+			// Send USB Packet
+			usb_tx( NKRO_KEYBOARD_ENDPOINT, tx_packet );
+			usb_keyboard_pending &= ~USBKeyChangeState_System; // Mark sent
 		}
-		else if ( USBKeys_Protocol == 1 ) // NKRO Mode
+
+		// Check consumer control keys
+		if ( usb_keyboard_pending & USBKeyChangeState_Consumer )
 		{
-			if ( usb_tx_packet_count( KEYBOARD_ENDPOINT ) < TX_PACKET_LIMIT )
-			{
-				tx_packet = usb_malloc();
-				if ( tx_packet )
-					break;
-			}
+			tx_packet = usb_keyboard_malloc( NKRO_KEYBOARD_ENDPOINT );
+			if ( !tx_packet )
+				break;
+			tx_buf = tx_packet->buf;
+
+			*tx_buf++ = 0x03; // ID
+			*tx_buf++ = (uint8_t)(pending_consctrl & 0x00FF);
+			*tx_buf   = (uint8_t)(pending_consctrl >> 8);
+			tx_packet->len = 3;
+
+			// Send USB Packet
+			usb_tx( NKRO_KEYBOARD_ENDPOINT, tx_packet );
+			usb_keyboard_pending &= ~USBKeyChangeState_Consumer; // Mark sent
 		}
 
-		if ( ++wait_count > TX_TIMEOUT || transmit_previous_timeout )
+		// Standard HID Keyboard
+		if ( usb_keyboard_pending )
 		{
-			transmit_previous_timeout = 1;
-			warn_print("USB Transmit Timeout...");
-			return;
+			tx_packet = usb_keyboard_malloc( NKRO_KEYBOARD_ENDPOINT );
+			if ( !tx_packet )
+				break;
+			tx_buf = tx_packet->buf;
+
+			// Modifiers
+			*tx_buf++ = 0x01; // ID
+			*tx_buf++ = pending_modifiers;
+
+			// 4-49 (first 6 bytes)
+			// 51-155 (Middle 14 bytes)
+			// 157-164 (Next byte)
+			// 176-221 (last 6 bytes)
+			memcpy( tx_buf, pending_keys, USB_NKRO_BITFIELD_SIZE_KEYS );
+			tx_packet->len = 2 + USB_NKRO_BITFIELD_SIZE_KEYS;
+
+			// Send USB Packet
+			usb_tx( NKRO_KEYBOARD_ENDPOINT, tx_packet );
+			usb_keyboard_pending = USBKeyChangeState_None; // Mark sent
 		}
-		yield();
+
+		break;
+
+	default:
+		usb_keyboard_pending = USBKeyChangeState_None;
+		break;
 	}
 
-	// Pointer to USB tx packet buffer
-	uint8_t *tx_buf = tx_packet->buf;
+	usb_keyboard_busy = 0;
+}
+
+
+// Called by the USB ISR on SOF and keyboard endpoint TX complete
+void usb_keyboard_flush_callback()
+{
+	if ( usb_keyboard_pending )
+		usb_keyboard_flush();
+}
+
+
+// Queue the contents of keyboard_keys and keyboard_modifier_keys
+// Never waits on the host, if there are no free packets the report is kept
+// pending and merged with any following changes
+void usb_keyboard_send()
+{
+	if ( !usb_configuration )
+	{
+		// Changes are left in USBKeys_Changed until the host is ready
+		return;
+	}
 
 	switch ( USBKeys_Protocol )
 	{
-	// Send boot keyboard interrupt packet(s)
 	case 0:
 		// USB Boot Mode debug output
-		if ( Output_DebugMode )
+		if ( log_enabled( LogLevel_Debug ) && Output_DebugMode )
 		{
 			dbug_msg("Boot USB: ");
 			printHex_op( USBKeys_Modifiers, 2 );
@@ -138,69 +232,26 @@ void usb_keyboard_send()
 			printHex_op( USBKeys_Keys[5], 2 );
 			print( NL );
 		}
-
-		// Boot Mode
-		*tx_buf++ = USBKeys_Modifiers;
-		*tx_buf++ = 0;
-		memcpy( tx_buf, USBKeys_Keys, USB_BOOT_MAX_KEYS );
-		tx_packet->len = 8;
-
-		// Send USB Packet
-		usb_tx( KEYBOARD_ENDPOINT, tx_packet );
-		USBKeys_Changed = USBKeyChangeState_None;
 		break;
 
-	// Send NKRO keyboard interrupts packet(s)
 	case 1:
-		if ( Output_DebugMode )
+		// USB NKRO Debug output
+		if ( log_enabled( LogLevel_Debug ) && Output_DebugMode )
 		{
 			dbug_msg("NKRO USB: ");
-		}
-
-		// Check system control keys
-		if ( USBKeys_Changed & USBKeyChangeState_System )
-		{
-			if ( Output_DebugMode )
+			if ( USBKeys_Changed & USBKeyChangeState_System )
 			{
 				print("SysCtrl[");
 				printHex_op( USBKeys_SysCtrl, 2 );
 				print( "] " NL );
 			}
-
-			*tx_buf++ = 0x02; // ID
-			*tx_buf   = USBKeys_SysCtrl;
-			tx_packet->len = 2;
-
-			// Send USB Packet
-			usb_tx( NKRO_KEYBOARD_ENDPOINT, tx_packet );
-			USBKeys_Changed &= ~USBKeyChangeState_System; // Mark sent
-		}
-
-		// Check consumer control keys
-		if ( USBKeys_Changed & USBKeyChangeState_Consumer )
-		{
-			if ( Output_DebugMode )
+			if ( USBKeys_Changed & USBKeyChangeState_Consumer )
 			{
 				print("ConsCtrl[");
 				printHex_op( USBKeys_ConsCtrl, 2 );
 				print( "] " NL );
 			}
-
-			*tx_buf++ = 0x03; // ID
-			*tx_buf++ = (uint8_t)(USBKeys_ConsCtrl & 0x00FF);
-			*tx_buf   = (uint8_t)(USBKeys_ConsCtrl >> 8);
-			tx_packet->len = 3;
-
-			// Send USB Packet
-			usb_tx( NKRO_KEYBOARD_ENDPOINT, tx_packet );
-			USBKeys_Changed &= ~USBKeyChangeState_Consumer; // Mark sent
-		}
-
-		// Standard HID Keyboard
-		if ( USBKeys_Changed )
-		{
-			// USB NKRO Debug output
-			if ( Output_DebugMode )
+			if ( USBKeys_Changed & ~( USBKeyChangeState_System | USBKeyChangeState_Consumer ) )
 			{
 				printHex_op( USBKeys_Modifiers, 2 );
 				print(" ");
@@ -216,41 +267,30 @@ void usb_keyboard_send()
 					printHex_op( USBKeys_Keys[ c ], 2 );
 				print( NL );
 			}
+		}
+		break;
+	}
 
-			tx_packet->len = 0;
-
-			// Modifiers
-			*tx_buf++ = 0x01; // ID
-			*tx_buf++ = USBKeys_Modifiers;
-			tx_packet->len += 2;
-
-			// 4-49 (first 6 bytes)
-			memcpy( tx_buf, USBKeys_Keys, 6 );
-			tx_buf += 6;
-			tx_packet->len += 6;
+	// Snapshot the current state, merging with any report not yet sent
+	// The ISR never touches the snapshot while the main loop holds it
+	__disable_irq();
+	if ( usb_keyboard_pending )
+		usb_keyboard_coalesced++;
 
-			// 51-155 (Middle 14 bytes)
-			memcpy( tx_buf, USBKeys_Keys + 6, 14 );
-			tx_buf += 14;
-			tx_packet->len += 14;
+	// A protocol change invalidates the old report, resend everything
+	if ( pending_protocol != USBKeys_Protocol )
+		usb_keyboard_pending |= USBKeyChangeState_All;
 
-			// 157-164 (Next byte)
-			memcpy( tx_buf, USBKeys_Keys + 20, 1 );
-			tx_buf += 1;
-			tx_packet->len += 1;
+	pending_protocol  = USBKeys_Protocol;
+	pending_modifiers = USBKeys_Modifiers;
+	pending_sysctrl   = USBKeys_SysCtrl;
+	pending_consctrl  = USBKeys_ConsCtrl;
+	memcpy( pending_keys, USBKeys_Keys, USB_NKRO_BITFIELD_SIZE_KEYS );
+	usb_keyboard_pending |= USBKeys_Changed;
+	__enable_irq();
 
-			// 176-221 (last 6 bytes)
-			memcpy( tx_buf, USBKeys_Keys + 21, 6 );
-			tx_packet->len += 6;
+	USBKeys_Changed = USBKeyChangeState_None;
 
-			// Send USB Packet
-			usb_tx( NKRO_KEYBOARD_ENDPOINT, tx_packet );
-			USBKeys_Changed = USBKeyChangeState_None; // Mark sent
-		}
-
-		break;
-	}
-
-	return;
+	// Try to send right away, otherwise the USB ISR will pick it up
+	usb_keyboard_flush();
 }
-
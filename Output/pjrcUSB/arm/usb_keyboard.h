@@ -41,7 +41,14 @@
 
 
 
+// ----- Variables -----
+
+extern volatile uint32_t usb_keyboard_coalesced; // Reports merged while waiting for a free packet
+
+
+
 // ----- Functions -----
 
 void usb_keyboard_send();
+void usb_keyboard_flush_callback();
 
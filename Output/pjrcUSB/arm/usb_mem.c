@@ -40,12 +40,36 @@
 
 
 
+// ----- Defines -----
+
+// Reserved packets sit at the start of the pool, the rest is shared by all endpoints
+#define USB_RESERVED_BUFFERS ( KEYBOARD_RESERVED_BUFFERS + NKRO_KEYBOARD_RESERVED_BUFFERS )
+
+
+
+// ----- Macros -----
+
+// Availability bits for n packets, starting at packet index start
+// Packet 0 is the MSB so that CLZ returns the packet index
+#define usb_buffer_mask( start, n ) ( (uint32_t)( ( 0xFFFFFFFFULL << ( 32 - (n) ) ) & 0xFFFFFFFF ) >> (start) )
+
+#define USB_GENERAL_MASK usb_buffer_mask( USB_RESERVED_BUFFERS, NUM_USB_BUFFERS - USB_RESERVED_BUFFERS )
+
+
+
 // ----- Variables -----
 
 __attribute__ ((section(".usbbuffers"), used))
 unsigned char usb_buffer_memory[ NUM_USB_BUFFERS * sizeof(usb_packet_t) ];
 
-static uint32_t usb_buffer_available = 0xFFFFFFFF;
+static volatile uint32_t usb_buffer_available = usb_buffer_mask( 0, NUM_USB_BUFFERS );
+
+// Packets each endpoint may use on top of the general pool
+// Keyboard endpoints always keep a packet, so CDC output can never starve keystrokes
+static const uint32_t usb_buffer_reserved[ NUM_ENDPOINTS ] = {
+	[ KEYBOARD_ENDPOINT - 1 ]      = usb_buffer_mask( 0, KEYBOARD_RESERVED_BUFFERS ),
+	[ NKRO_KEYBOARD_ENDPOINT - 1 ] = usb_buffer_mask( KEYBOARD_RESERVED_BUFFERS, NKRO_KEYBOARD_RESERVED_BUFFERS ),
+};
 
 
 
@@ -60,27 +84,43 @@ extern uint8_t usb_rx_memory_needed;
 
 // ----- Functions -----
 
+// Exclusive load/store, the store fails (returns 1) if anything else touched the
+// pool in between, including any interrupt (exception entry/exit clears the monitor)
+static inline uint32_t usb_buffer_ldrex( volatile uint32_t *addr )
+{
+	uint32_t val;
+	asm volatile ( "ldrex %0, [%1]" : "=r" (val) : "r" (addr) : "memory" );
+	return val;
+}
+
+static inline uint32_t usb_buffer_strex( uint32_t val, volatile uint32_t *addr )
+{
+	uint32_t fail;
+	asm volatile ( "strex %0, %1, [%2]" : "=&r" (fail) : "r" (val), "r" (addr) : "memory" );
+	return fail;
+}
+
+
 // use bitmask and CLZ instruction to implement fast free list
 // http://www.archivum.info/gnu.gcc.help/2006-08/00148/Re-GCC-Inline-Assembly.html
 // http://gcc.gnu.org/ml/gcc/2012-06/msg00015.html
 // __builtin_clz()
-
-usb_packet_t *usb_malloc()
+// Lock-free, safe to call from both the main loop and interrupts
+static usb_packet_t *usb_malloc_mask( uint32_t allowed )
 {
 	unsigned int n, avail;
 	uint8_t *p;
 
-	__disable_irq();
-	avail = usb_buffer_available;
-	n = __builtin_clz( avail ); // clz = count leading zeros
-	if ( n >= NUM_USB_BUFFERS )
-	{
-		__enable_irq();
-		return NULL;
-	}
+	do {
+		avail = usb_buffer_ldrex( &usb_buffer_available );
+		if ( !( avail & allowed ) )
+		{
+			asm volatile ( "clrex" ::: "memory" );
+			return NULL;
+		}
+		n = __builtin_clz( avail & allowed ); // clz = count leading zeros
+	} while ( usb_buffer_strex( avail & ~(0x80000000 >> n), &usb_buffer_available ) );
 
-	usb_buffer_available = avail & ~(0x80000000 >> n);
-	__enable_irq();
 	p = usb_buffer_memory + ( n * sizeof(usb_packet_t) );
 	*(uint32_t *)p = 0;
 	*(uint32_t *)(p + 4) = 0;
@@ -88,25 +128,57 @@ usb_packet_t *usb_malloc()
 }
 
 
+// Allocate from the general pool only
+usb_packet_t *usb_malloc()
+{
+	return usb_malloc_mask( USB_GENERAL_MASK );
+}
+
+
+// Allocate for a specific endpoint
+// Reserved packets are only used once the general pool is empty
+usb_packet_t *usb_malloc_endpoint( uint32_t endpoint )
+{
+	usb_packet_t *p;
+
+	endpoint--;
+	if ( endpoint >= NUM_ENDPOINTS )
+		return NULL;
+
+	p = usb_malloc_mask( USB_GENERAL_MASK );
+	if ( !p && usb_buffer_reserved[ endpoint ] )
+		p = usb_malloc_mask( usb_buffer_reserved[ endpoint ] );
+	return p;
+}
+
+
+// Number of packets currently free, reserved packets included
+uint32_t usb_malloc_free_count()
+{
+	return __builtin_popcount( usb_buffer_available );
+}
+
+
 void usb_free( usb_packet_t *p )
 {
-	unsigned int n, mask;
+	unsigned int n, mask, avail;
 
 	n = ( (uint8_t *)p - usb_buffer_memory ) / sizeof(usb_packet_t);
 	if ( n >= NUM_USB_BUFFERS )
 		return;
+	mask = (0x80000000 >> n);
 
 	// if any endpoints are starving for memory to receive
 	// packets, give this memory to them immediately!
-	if ( usb_rx_memory_needed && usb_configuration )
+	// Reserved packets always go back to their endpoint
+	if ( usb_rx_memory_needed && usb_configuration && ( mask & USB_GENERAL_MASK ) )
 	{
 		usb_rx_memory( p );
 		return;
 	}
 
-	mask = (0x80000000 >> n);
-	__disable_irq();
-	usb_buffer_available |= mask;
-	__enable_irq();
+	do {
+		avail = usb_buffer_ldrex( &usb_buffer_available );
+	} while ( usb_buffer_strex( avail | mask, &usb_buffer_available ) );
 }
 
@@ -52,5 +52,8 @@ typedef struct usb_packet_struct {
 // ----- Functions -----
 
 usb_packet_t *usb_malloc();
+usb_packet_t *usb_malloc_endpoint( uint32_t endpoint );
 void usb_free( usb_packet_t *p );
 
+uint32_t usb_malloc_free_count();
+
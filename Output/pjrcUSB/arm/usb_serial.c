@@ -48,6 +48,7 @@
 #define TRANSMIT_FLUSH_TIMEOUT  5   /* in milliseconds */
 
 // Maximum number of transmit packets to queue so we don't starve other endpoints for memory
+// Counts both the filled packets waiting for the SOF interrupt and the ones already on the endpoint
 #define TX_PACKET_LIMIT 8
 
 // When the PC isn't listening, how long do we wait before discarding data?  If this is
@@ -79,6 +80,12 @@ static usb_packet_t *rx_packet = NULL;
 static usb_packet_t *tx_packet = NULL;
 static volatile uint8_t tx_noautoflush = 0;
 
+// Filled packets, queued on the endpoint from the SOF interrupt rather than inline
+// Only touched by the ISR while tx_noautoflush is clear
+static usb_packet_t *tx_queue_first = NULL;
+static usb_packet_t *tx_queue_last  = NULL;
+static volatile uint8_t tx_queue_count = 0;
+
 // When we've suffered the transmit timeout, don't wait again until the computer
 // begins accepting data.  If no software is running to receive, we'll just discard
 // data as rapidly as Serial.print() can generate it, until there's something to
@@ -208,12 +215,66 @@ int usb_serial_putchar( uint8_t c )
 	return usb_serial_write( &c, 1 );
 }
 
+// Unaligned word access, single LDR/STR on Cortex-M4
+typedef struct {
+	uint32_t word;
+} __attribute__((packed)) usb_serial_word_t;
+
+// Copy into a packet buffer, a word at a time once the destination is aligned
+static inline void usb_serial_copy( uint8_t *dest, const uint8_t *src, uint32_t len )
+{
+	while ( len > 0 && ( (uintptr_t)dest & 3 ) )
+	{
+		*dest++ = *src++;
+		len--;
+	}
+	while ( len >= 4 )
+	{
+		*(uint32_t *)dest = ((const usb_serial_word_t *)src)->word;
+		dest += 4;
+		src += 4;
+		len -= 4;
+	}
+	while ( len-- > 0 )
+		*dest++ = *src++;
+}
+
+// Queue a filled packet, sent on the next SOF
+static inline void usb_serial_queue( usb_packet_t *packet )
+{
+	packet->next = NULL;
+	if ( tx_queue_first == NULL )
+		tx_queue_first = packet;
+	else
+		tx_queue_last->next = packet;
+	tx_queue_last = packet;
+	tx_queue_count++;
+}
+
+// Hand queued packets to the endpoint, returns 1 if any are still waiting
+static uint8_t usb_serial_queue_send( uint8_t limit )
+{
+	usb_packet_t *packet;
+
+	while ( tx_queue_first )
+	{
+		if ( limit && usb_tx_packet_count( CDC_TX_ENDPOINT ) >= TX_PACKET_LIMIT )
+			return 1;
+
+		packet = tx_queue_first;
+		tx_queue_first = packet->next;
+		tx_queue_count--;
+		usb_tx( CDC_TX_ENDPOINT, packet );
+	}
+	tx_queue_last = NULL;
+	return 0;
+}
+
 int usb_serial_write( const void *buffer, uint32_t size )
 {
 	uint32_t len;
 	uint32_t wait_count;
 	const uint8_t *src = (const uint8_t *)buffer;
-	uint8_t *dest;
 
 	tx_noautoflush = 1;
 	while ( size > 0 )
@@ -228,39 +289,43 @@ int usb_serial_write( const void *buffer, uint32_t size )
 					tx_noautoflush = 0;
 					return -1;
 				}
-				if ( usb_tx_packet_count( CDC_TX_ENDPOINT ) < TX_PACKET_LIMIT )
+				if ( tx_queue_count + usb_tx_packet_count( CDC_TX_ENDPOINT ) < TX_PACKET_LIMIT )
 				{
-					tx_noautoflush = 1;
 					tx_packet = usb_malloc();
 					if ( tx_packet )
 						break;
-					tx_noautoflush = 0;
 				}
 				if ( ++wait_count > TX_TIMEOUT || transmit_previous_timeout )
 				{
 					transmit_previous_timeout = 1;
+					tx_noautoflush = 0;
 					return -1;
 				}
+
+				// Let the SOF interrupt drain the queue while waiting
+				tx_noautoflush = 0;
 				yield();
+				tx_noautoflush = 1;
 			}
 		}
 		transmit_previous_timeout = 0;
 		len = CDC_TX_SIZE - tx_packet->index;
 		if ( len > size )
 			len = size;
-		dest = tx_packet->buf + tx_packet->index;
+		usb_serial_copy( tx_packet->buf + tx_packet->index, src, len );
 		tx_packet->index += len;
+		src += len;
 		size -= len;
-		while ( len-- > 0 )
-			*dest++ = *src++;
 		if ( tx_packet->index >= CDC_TX_SIZE )
 		{
 			tx_packet->len = CDC_TX_SIZE;
-			usb_tx( CDC_TX_ENDPOINT, tx_packet );
+			usb_serial_queue( tx_packet );
 			tx_packet = NULL;
 		}
-		usb_cdc_transmit_flush_timer = TRANSMIT_FLUSH_TIMEOUT;
 	}
+
+	// Full packets go out on the next SOF, partial ones once output goes idle
+	usb_cdc_transmit_flush_timer = tx_queue_first ? 1 : TRANSMIT_FLUSH_TIMEOUT;
 	tx_noautoflush = 0;
 	return 0;
 }
@@ -270,6 +335,7 @@ void usb_serial_flush_output()
 	if ( !usb_configuration )
 		return;
 	tx_noautoflush = 1;
+	usb_serial_queue_send( 0 );
 	if ( tx_packet )
 	{
 		usb_cdc_transmit_flush_timer = 0;
@@ -293,10 +359,24 @@ void usb_serial_flush_output()
 	tx_noautoflush = 0;
 }
 
+// Called from the SOF interrupt when usb_cdc_transmit_flush_timer expires
 void usb_serial_flush_callback()
 {
 	if ( tx_noautoflush )
+	{
+		// Writer is busy, try again next frame
+		usb_cdc_transmit_flush_timer = 1;
+		return;
+	}
+
+	// Queued packets first, the partial packet must not overtake them
+	// Once the queue is drained, the idle timeout starts over
+	if ( tx_queue_first )
+	{
+		usb_cdc_transmit_flush_timer = usb_serial_queue_send( 1 ) ? 1 : TRANSMIT_FLUSH_TIMEOUT;
 		return;
+	}
+
 	if ( tx_packet )
 	{
 		tx_packet->len = tx_packet->index;
@@ -0,0 +1,197 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Host benchmark for the CDC serial transmit path (arm/usb_serial.c)
+// The USB packet layer (usb_mem/usb_dev) is replaced by a stand-in, the host
+// side drains the CDC endpoint at full speed bulk rates (19 packets per frame).
+//
+// Build (from this directory):
+//   cc -O2 -DF_CPU=72000000 -I. -I.. -I../../.. -o usb_serial_bench usb_serial_bench.c
+//
+// Usage:
+//   ./usb_serial_bench [message length] [writes per SOF] [total writes]
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Device Includes
+void yield( void );
+
+#include "../arm/usb_serial.c"
+
+
+
+// ----- Defines -----
+
+// Full speed bulk, packets the host can take per 1 ms frame
+#define HOST_PACKETS_PER_FRAME 19
+
+#define HOST_QUEUE_SIZE 64
+
+
+
+// ----- Variables -----
+
+volatile uint8_t usb_configuration = 1;
+uint16_t usb_rx_byte_count_data[ NUM_ENDPOINTS ];
+
+// Stand-in packet pool
+static usb_packet_t host_pool[ NUM_USB_BUFFERS ];
+static usb_packet_t *host_free = NULL;
+
+// Packets queued on the CDC endpoint
+static usb_packet_t *host_tx[ HOST_QUEUE_SIZE ];
+static uint32_t host_tx_head = 0;
+static uint32_t host_tx_tail = 0;
+
+static uint64_t host_bytes   = 0;
+static uint64_t host_packets = 0;
+static uint64_t host_frames  = 0;
+
+
+
+// ----- Stand-in Functions -----
+
+usb_packet_t *usb_malloc()
+{
+	usb_packet_t *p = host_free;
+	if ( p )
+	{
+		host_free = p->next;
+		p->len = 0;
+		p->index = 0;
+		p->next = NULL;
+	}
+	return p;
+}
+
+void usb_free( usb_packet_t *p )
+{
+	p->next = host_free;
+	host_free = p;
+}
+
+usb_packet_t *usb_rx( uint32_t endpoint )
+{
+	return NULL;
+}
+
+uint32_t usb_tx_packet_count( uint32_t endpoint )
+{
+	return host_tx_head - host_tx_tail;
+}
+
+void usb_tx( uint32_t endpoint, usb_packet_t *packet )
+{
+	if ( host_tx_head - host_tx_tail >= HOST_QUEUE_SIZE )
+	{
+		fprintf( stderr, "Endpoint queue overflow\n" );
+		exit( 1 );
+	}
+	host_tx[ host_tx_head++ % HOST_QUEUE_SIZE ] = packet;
+}
+
+// What usb_isr does on SOF, plus the host reading the endpoint
+static void host_sof()
+{
+	host_frames++;
+
+	for ( int c = 0; c < HOST_PACKETS_PER_FRAME && host_tx_tail != host_tx_head; c++ )
+	{
+		usb_packet_t *p = host_tx[ host_tx_tail++ % HOST_QUEUE_SIZE ];
+		host_bytes += p->len;
+		host_packets++;
+		usb_free( p );
+	}
+
+	uint8_t t = usb_cdc_transmit_flush_timer;
+	if ( t )
+	{
+		usb_cdc_transmit_flush_timer = --t;
+		if ( t == 0 )
+			usb_serial_flush_callback();
+	}
+}
+
+// Called while usb_serial_write waits for packets, the SOF interrupt keeps running
+void yield( void )
+{
+	host_sof();
+}
+
+
+
+// ----- Functions -----
+
+static double host_now()
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main( int argc, char **argv )
+{
+	uint32_t msg_len   = argc > 1 ? atoi( argv[1] ) : 24;
+	uint32_t sof_every = argc > 2 ? atoi( argv[2] ) : 16;
+	uint32_t writes    = argc > 3 ? atoi( argv[3] ) : 1000000;
+
+	char *msg = malloc( msg_len );
+	for ( uint32_t c = 0; c < msg_len; c++ )
+		msg[c] = 'A' + c % 26;
+
+	for ( int c = 0; c < NUM_USB_BUFFERS; c++ )
+		usb_free( &host_pool[c] );
+
+	uint64_t failed = 0;
+	double start = host_now();
+	for ( uint32_t c = 0; c < writes; c++ )
+	{
+		if ( usb_serial_write( msg, msg_len ) )
+			failed++;
+		if ( c % sof_every == sof_every - 1 )
+			host_sof();
+	}
+	double elapsed = host_now() - start;
+
+	// Drain whatever is left
+	while ( tx_queue_first || tx_packet || host_tx_head != host_tx_tail )
+	{
+		if ( tx_queue_first || tx_packet )
+			usb_cdc_transmit_flush_timer = 1;
+		host_sof();
+	}
+
+	printf( "Writes:         %u x %u bytes\n", writes, msg_len );
+	printf( "Failed writes:  %llu\n", (unsigned long long)failed );
+	printf( "Bytes received: %llu (%llu packets, %llu frames)\n",
+		(unsigned long long)host_bytes, (unsigned long long)host_packets, (unsigned long long)host_frames );
+	printf( "Write rate:     %.1f MB/s\n", (double)writes * msg_len / elapsed / 1e6 );
+	printf( "Per call:       %.1f ns\n", elapsed / writes * 1e9 );
+
+	free( msg );
+	return 0;
+}
+
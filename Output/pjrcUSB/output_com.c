@@ -26,6 +26,7 @@
 
 // Project Includes
 #include <cli.h>
+#include <control.h>
 #include <led.h>
 #include <print.h>
 #include <scan_loop.h>
@@ -66,6 +67,9 @@ void cliFunc_readLEDs   ( char* args );
 void cliFunc_sendKeys   ( char* args );
 void cliFunc_setKeys    ( char* args );
 void cliFunc_setMod     ( char* args );
+void cliFunc_usbStats   ( char* args );
+
+uint8_t Output_controlUsbCounters( uint8_t* data, uint8_t len );
 
 
 
@@ -78,6 +82,7 @@ CLIDict_Entry( readLEDs,    "Read LED byte:" NL "\t\t1 NumLck, 2 CapsLck, 4 Scrl
 CLIDict_Entry( sendKeys,    "Send the prepared list of USB codes and modifier byte." );
 CLIDict_Entry( setKeys,     "Prepare a space separated list of USB codes (decimal). Waits until \033[35msendKeys\033[0m." );
 CLIDict_Entry( setMod,      "Set the modfier byte:" NL "\t\t1 LCtrl, 2 LShft, 4 LAlt, 8 LGUI, 16 RCtrl, 32 RShft, 64 RAlt, 128 RGUI" );
+CLIDict_Entry( usbStats,    "Show USB keyboard transmit statistics." );
 
 CLIDict_Def( outputCLIDict, "USB Module Commands" ) = {
 	CLIDict_Item( kbdProtocol ),
@@ -86,9 +91,16 @@ CLIDict_Def( outputCLIDict, "USB Module Commands" ) = {
 	CLIDict_Item( sendKeys ),
 	CLIDict_Item( setKeys ),
 	CLIDict_Item( setMod ),
+	CLIDict_Item( usbStats ),
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
+// Output Module control requests
+const ControlItem outputControlDict[] = {
+	{ ControlId_UsbCounters, Output_controlUsbCounters },
+	{ 0, 0 } // Null entry for dictionary end
+};
+
 
 // Which modifier keys are currently pressed
 // 1=left ctrl,    2=left shift,   4=left alt,    8=left gui
@@ -515,6 +527,7 @@ inline void Output_setup()
 
 	// Register USB Output CLI dictionary
 	CLI_registerDictionary( outputCLIDict, outputCLIDictName );
+	Control_registerDictionary( outputControlDict );
 
 	// Flush key buffers
 	Output_flushBuffers();
@@ -529,8 +542,9 @@ inline void Output_send()
 		for ( uint8_t c = USBKeys_Sent; c < USB_BOOT_MAX_KEYS; c++ )
 			USBKeys_Keys[c] = 0;
 
-	// Send keypresses while there are pending changes
-	while ( USBKeys_Changed )
+	// Send keypresses if there are pending changes
+	// Never blocks, if USB is backed up the changes are merged and sent from the USB ISR
+	if ( USBKeys_Changed )
 		usb_keyboard_send();
 
 	// Clear keys sent
@@ -688,3 +702,37 @@ void cliFunc_setMod( char* args )
 	USBKeys_ModifiersCLI = numToInt( arg1Ptr );
 }
 
+
+void cliFunc_usbStats( char* args )
+{
+	print( NL );
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) // ARM
+	info_msg("Coalesced Reports: ");
+	printInt32( usb_keyboard_coalesced );
+	print( NL );
+	info_msg("Free Packets: ");
+	printInt32( usb_malloc_free_count() );
+#else
+	warn_print("Not supported on this platform");
+#endif
+}
+
+
+
+// ----- Control Request Functions -----
+
+uint8_t Output_controlUsbCounters( uint8_t* data, uint8_t len )
+{
+#if defined(_mk20dx128_) || defined(_mk20dx128vlf5_) || defined(_mk20dx256_) || defined(_mk20dx256vlh7_) // ARM
+	// <coalesced reports u32> <free packets u32>
+	uint32_t counters[] = { usb_keyboard_coalesced, usb_malloc_free_count() };
+
+	Control_replyBegin( sizeof( counters ) );
+	Control_write( (uint8_t*)counters, sizeof( counters ) );
+
+	return ControlStatus_Ok;
+#else
+	return ControlStatus_Unknown;
+#endif
+}
+
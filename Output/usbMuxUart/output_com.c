@@ -492,8 +492,9 @@ inline void Output_send()
 		for ( uint8_t c = USBKeys_Sent; c < USB_BOOT_MAX_KEYS; c++ )
 			USBKeys_Keys[c] = 0;
 
-	// Send keypresses while there are pending changes
-	while ( USBKeys_Changed )
+	// Send keypresses if there are pending changes
+	// Never blocks, if USB is backed up the changes are merged and sent from the USB ISR
+	if ( USBKeys_Changed )
 		usb_keyboard_send();
 
 	// Clear modifiers and keys
@@ -0,0 +1,120 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host renderer for the LED animation engine (led_anim.c)
+// Computes frames the same way LED_scan does (a chunk of channels at a time) and writes them to a
+// PGM image, one 16x9 tile per frame (C1-1 -> C9-16, as laid out in the ISSI frame page), top to bottom.
+// The reactive animation is hit on a pseudo-random channel every few frames.
+//
+// Build (from this directory):
+//   cc -O2 -I.. -o led_render led_render.c ../led_anim.c
+//
+// Usage:
+//   ./led_render <animation> [frames] [output.pgm] [frame periods per frame]
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdio.h>
+#include <stdlib.h>
+
+// Local Includes
+#include "led_anim.h"
+
+
+
+// ----- Defines -----
+
+// Same chunk size as LED_scan
+#define Chunk 16
+
+#define TileWidth  16
+#define TileHeight ( LED_BufferLength / TileWidth )
+#define Scale      4
+
+// Frames between simulated key hits
+#define HitInterval 5
+
+
+
+// ----- Functions -----
+
+int main( int argc, char **argv )
+{
+	if ( argc < 2 )
+	{
+		fprintf( stderr, "Usage: %s <animation> [frames] [output.pgm] [frame periods per frame]\n", argv[0] );
+		fprintf( stderr, "  animation: 1 - Breathe, 2 - Gradient, 3 - Reactive\n" );
+		return 1;
+	}
+
+	uint8_t  id      = atoi( argv[1] );
+	uint32_t frames  = argc > 2 ? atoi( argv[2] ) : 64;
+	char    *output  = argc > 3 ? argv[3] : "led_render.pgm";
+	uint16_t elapsed = argc > 4 ? atoi( argv[4] ) : 1;
+
+	FILE *fp = fopen( output, "wb" );
+	if ( !fp )
+	{
+		perror( output );
+		return 1;
+	}
+	fprintf( fp, "P5\n%d %d\n255\n", TileWidth * Scale, TileHeight * Scale * frames );
+
+	LED_animationSelect( id );
+
+	LED_Buffer frame;
+	uint32_t seed = 1;
+	uint32_t steps = 0;
+	for ( uint32_t f = 0; f < frames; f++ )
+	{
+		if ( f % HitInterval == 0 )
+		{
+			seed = seed * 1103515245 + 12345;
+			LED_animationHit( ( seed >> 16 ) % LED_BufferLength );
+		}
+
+		LED_animationBegin( f == 0 ? 0 : elapsed );
+		while ( !LED_animationStep( &frame, Chunk ) )
+			steps++;
+		steps++;
+
+		// Summary of the frame
+		uint32_t sum = 0;
+		uint8_t min = 0xFF;
+		uint8_t max = 0;
+		for ( uint16_t ch = 0; ch < LED_BufferLength; ch++ )
+		{
+			sum += frame.buffer[ ch ];
+			if ( frame.buffer[ ch ] < min ) min = frame.buffer[ ch ];
+			if ( frame.buffer[ ch ] > max ) max = frame.buffer[ ch ];
+		}
+		printf( "frame %4u (t=%5u): min %3u max %3u avg %3u\n",
+			f, LED_animationFrame, min, max, sum / LED_BufferLength );
+
+		// Scaled up tile
+		for ( uint16_t y = 0; y < TileHeight * Scale; y++ )
+		{
+			for ( uint16_t x = 0; x < TileWidth * Scale; x++ )
+				fputc( frame.buffer[ ( y / Scale ) * TileWidth + x / Scale ], fp );
+		}
+	}
+
+	fclose( fp );
+	printf( "%u frames, %u steps of %d channels -> %s\n", frames, steps, Chunk, output );
+	return 0;
+}
+
@@ -0,0 +1,625 @@
+/* Copyright (C) 2014-2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/ScanLib.h>
+
+// Project Includes
+#include <cli.h>
+#include <print.h>
+#include <trace.h>
+
+// Local Includes
+#include "i2c.h"
+
+
+
+// ----- Defines -----
+
+// Tx DMA uses channel 2 (UARTConnect uses channels 0 and 1)
+#define I2C_DMAChannel 2
+
+// Largest write sequence accepted by the CLI commands
+#define I2C_CLIBufferLength 8
+
+
+
+// ----- Enums -----
+
+// Bus state machine, advanced by the I2C and DMA ISRs
+typedef enum I2C_State {
+	I2C_State_Idle,        // STOP sent (or never started)
+	I2C_State_Write,       // Address and write bytes are being sent by DMA
+	I2C_State_WriteDone,   // Last write byte loaded, waiting for it to finish
+	I2C_State_ReadAddress, // Address with the read bit is being sent
+	I2C_State_Read,        // Receiving
+} I2C_State;
+
+
+
+// ----- Structs -----
+
+// Queued transaction
+typedef struct I2C_Entry {
+	uint8_t       address;
+	uint8_t       readLen;
+	uint8_t       readPos;
+	uint8_t       status;
+	uint16_t      writeLen;
+	uint16_t      dataPos;  // Start of the write bytes in I2C_data
+	uint8_t      *readData;
+	I2C_Callback  callback;
+	void         *context;
+} I2C_Entry;
+
+
+
+// ----- Function Declarations -----
+
+// CLI Functions
+void cliFunc_i2cRecv( char* args );
+void cliFunc_i2cSend( char* args );
+void cliFunc_i2cStats( char* args );
+
+void I2C_start( uint8_t repeated );
+void I2C_startTxDMA();
+void I2C_complete( I2C_Status status, uint8_t stopped );
+
+
+
+// ----- Variables -----
+
+// I2C Module command dictionary
+CLIDict_Entry( i2cRecv,     "Send I2C sequence of bytes and expect a reply of 1 byte on the last sequence." NL "\t\tUse |'s to split sequences with a stop." );
+CLIDict_Entry( i2cSend,     "Send I2C sequence of bytes. Use |'s to split sequences with a stop." );
+CLIDict_Entry( i2cStats,    "Show I2C transaction queue statistics." );
+
+CLIDict_Def( i2cCLIDict, "I2C Module Commands" ) = {
+	CLIDict_Item( i2cRecv ),
+	CLIDict_Item( i2cSend ),
+	CLIDict_Item( i2cStats ),
+	{ 0, 0, 0 } // Null entry for dictionary end
+};
+
+// Transaction queue
+//  I2C_queueTail   - Next free entry, advanced by I2C_submit
+//  I2C_queueActive - Entry on the bus, advanced by the ISRs as each transaction finishes
+//  I2C_queueHead   - Oldest entry, advanced by I2C_process once the callback has been called
+I2C_Entry        I2C_queue[ I2C_QueueLength ];
+volatile uint8_t I2C_queueTail = 0;
+volatile uint8_t I2C_queueActive = 0;
+volatile uint8_t I2C_queueHead = 0;
+
+// Write bytes, freed by I2C_process along with the queue entry
+uint8_t  I2C_data[ I2C_DataLength ];
+uint16_t I2C_dataTail = 0;
+uint16_t I2C_dataUsed = 0;
+
+// Bus state
+volatile I2C_State I2C_state = I2C_State_Idle;
+volatile uint8_t   I2C_startPending = 0; // Waiting for a STOP to finish before starting the next transaction
+volatile uint16_t  I2C_dmaPos = 0;       // Next write byte to send
+volatile uint16_t  I2C_dmaLeft = 0;      // Write bytes not yet handed to the DMA
+
+// Statistics
+volatile uint32_t I2C_interrupts = 0;
+uint32_t          I2C_transactions = 0;
+uint32_t          I2C_errors = 0;
+uint32_t          I2C_queueFull = 0;
+
+// Last read requested by i2cRecv
+uint8_t I2C_cliRead;
+
+
+
+// ----- Interrupt Functions -----
+
+void i2c0_isr()
+{
+	cli(); // Disable Interrupts
+
+	uint8_t status = I2C0_S; // Read I2C Bus status
+	I2C_interrupts++;
+
+	I2C_Entry *entry = &I2C_queue[ I2C_queueActive & ( I2C_QueueLength - 1 ) ];
+
+	// Another master took the bus, the controller has already dropped back to slave mode
+	if ( status & I2C_S_ARBL )
+	{
+		trace1("I2C arbitration lost, address %02x", entry->address );
+		DMA_CERQ = I2C_DMAChannel;
+		I2C0_S = I2C_S_ARBL | I2C_S_IICIF; // Clear ARBL flag and interrupt
+		I2C0_C1 = I2C_C1_IICEN;
+		I2C_complete( I2C_Status_ArbitrationLost, 1 );
+		sei(); // Re-enable Interrupts
+		return;
+	}
+
+	switch ( I2C_state )
+	{
+	// Last write byte has been sent
+	case I2C_State_WriteDone:
+		if ( status & I2C_S_RXAK )
+		{
+			trace2("I2C NAK detected, address %02x (%u byte write)", entry->address, entry->writeLen );
+			I2C0_C1 = I2C_C1_IICEN; // Send STOP
+			I2C_complete( I2C_Status_NAK, 1 );
+			break;
+		}
+
+		// Read phase, keep the bus with a repeated START
+		if ( entry->readLen > 0 )
+		{
+			I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_RSTA | I2C_C1_TX;
+			I2C0_D = entry->address | 0x01;
+			I2C_state = I2C_State_ReadAddress;
+			break;
+		}
+
+		I2C_complete( I2C_Status_OK, 0 );
+		break;
+
+	// Read address has been sent
+	case I2C_State_ReadAddress:
+		if ( status & I2C_S_RXAK )
+		{
+			trace1("Slave Address I2C NAK detected, address %02x", entry->address );
+			I2C0_C1 = I2C_C1_IICEN; // Send STOP
+			I2C_complete( I2C_Status_NAK, 1 );
+			break;
+		}
+
+		// Switch to receive, NAK right away if there is only a single byte
+		I2C0_C1 = entry->readLen == 1
+			? I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK // Single byte read
+			: I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST; // Multi-byte read
+		I2C_state = I2C_State_Read;
+
+		// Dummy read starts receiving the first byte
+		(void)I2C0_D;
+		break;
+
+	// Byte received
+	case I2C_State_Read:
+		// Last byte, STOP before reading the data register so another byte isn't clocked in
+		if ( entry->readLen - entry->readPos == 1 )
+		{
+			I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
+			I2C0_C1 = I2C_C1_IICEN; // Send STOP
+			entry->readData[ entry->readPos++ ] = I2C0_D;
+			I2C_complete( I2C_Status_OK, 1 );
+			break;
+		}
+
+		// Second last byte, NAK the next one
+		if ( entry->readLen - entry->readPos == 2 )
+		{
+			I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK;
+		}
+
+		entry->readData[ entry->readPos++ ] = I2C0_D;
+		break;
+
+	// Spurious, nothing should be on the bus
+	default:
+		break;
+	}
+
+	I2C0_S = I2C_S_IICIF; // Clear interrupt
+
+	sei(); // Re-enable Interrupts
+}
+
+// I2C Tx DMA ISR, the DMA transfer has loaded its last byte into the data register
+void dma_ch2_isr()
+{
+	cli(); // Disable Interrupts
+
+	DMA_CINT = I2C_DMAChannel;
+	I2C_interrupts++;
+
+	// Write bytes wrap around the end of I2C_data, send the rest
+	if ( I2C_dmaLeft > 0 )
+	{
+		I2C_startTxDMA();
+	}
+	// Hand the completion of the last byte over to i2c0_isr
+	// The flag was set by every byte of the transfer, so clear it before enabling the interrupt
+	// If the last byte finished in the meantime, the interrupt has to be raised by hand
+	else
+	{
+		I2C_state = I2C_State_WriteDone;
+		I2C0_S = I2C_S_IICIF;
+		I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
+		if ( I2C0_S & I2C_S_TCF )
+			NVIC_SET_PENDING( IRQ_I2C0 );
+	}
+
+	sei(); // Re-enable Interrupts
+}
+
+
+
+// ----- Functions -----
+
+inline uint32_t I2C_irqSave()
+{
+	uint32_t primask;
+	__asm__ volatile ( "mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory" );
+	return primask;
+}
+
+inline void I2C_irqRestore( uint32_t primask )
+{
+	__asm__ volatile ( "msr primask, %0" :: "r" (primask) : "memory" );
+}
+
+inline void I2C_setup()
+{
+	// Register I2C CLI dictionary
+	CLI_registerDictionary( i2cCLIDict, i2cCLIDictName );
+
+	// Enable I2C internal clock
+	SIM_SCGC4 |= SIM_SCGC4_I2C0; // Bus 0
+
+	// External pull-up resistor
+	PORTB_PCR0 = PORT_PCR_ODE | PORT_PCR_SRE | PORT_PCR_DSE | PORT_PCR_MUX(2);
+	PORTB_PCR1 = PORT_PCR_ODE | PORT_PCR_SRE | PORT_PCR_DSE | PORT_PCR_MUX(2);
+
+	// SCL Frequency Divider
+	// 400kHz -> 120 (0x85) @ 48 MHz F_BUS
+	I2C0_F = 0x85;
+	I2C0_FLT = 4;
+	I2C0_C1 = I2C_C1_IICEN;
+	I2C0_C2 = I2C_C2_HDRS; // High drive select
+
+	// Tx DMA, 8 bit transfers from the write bytes to the data register on each transfer complete
+	SIM_SCGC6 |= SIM_SCGC6_DMAMUX;
+	SIM_SCGC7 |= SIM_SCGC7_DMA;
+	DMAMUX0_CHCFG2 = 0;
+	DMA_TCD2_SOFF = 1;
+	DMA_TCD2_ATTR = DMA_TCD_ATTR_SSIZE( DMA_TCD_ATTR_SIZE_8BIT ) | DMA_TCD_ATTR_DSIZE( DMA_TCD_ATTR_SIZE_8BIT );
+	DMA_TCD2_NBYTES_MLNO = 1;
+	DMA_TCD2_SLAST = 0;
+	DMA_TCD2_DADDR = &I2C0_D;
+	DMA_TCD2_DOFF = 0;
+	DMA_TCD2_DLASTSGA = 0;
+	DMAMUX0_CHCFG2 = DMAMUX_SOURCE_I2C0 | DMAMUX_ENABLE;
+	NVIC_ENABLE_IRQ( IRQ_DMA_CH2 );
+
+	// Enable I2C Interrupt
+	NVIC_ENABLE_IRQ( IRQ_I2C0 );
+}
+
+// Sends the contiguous part of the remaining write bytes
+// The DMA request is raised on each transfer complete, dma_ch2_isr runs once it's all loaded
+void I2C_startTxDMA()
+{
+	uint16_t count = I2C_dmaLeft;
+	if ( I2C_dmaPos + count > I2C_DataLength )
+		count = I2C_DataLength - I2C_dmaPos;
+
+	DMA_TCD2_SADDR = &I2C_data[ I2C_dmaPos ];
+	DMA_TCD2_CITER_ELINKNO = count;
+	DMA_TCD2_BITER_ELINKNO = count;
+	DMA_TCD2_CSR = DMA_TCD_CSR_INTMAJOR | DMA_TCD_CSR_DREQ;
+
+	I2C_dmaPos = I2C_dmaPos + count >= I2C_DataLength ? 0 : I2C_dmaPos + count;
+	I2C_dmaLeft -= count;
+
+	DMA_SERQ = I2C_DMAChannel;
+}
+
+// Starts the active transaction, called with interrupts disabled
+// repeated is set when the bus is still held from the previous transaction
+void I2C_start( uint8_t repeated )
+{
+	I2C_Entry *entry = &I2C_queue[ I2C_queueActive & ( I2C_QueueLength - 1 ) ];
+
+	// Clear status flags
+	I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
+
+	// Now we're the master (ah yisss), get ready to send stuffs
+	I2C0_C1 = repeated
+		? I2C_C1_IICEN | I2C_C1_MST | I2C_C1_RSTA | I2C_C1_TX
+		: I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX;
+
+	// Writes, the bytes after the address are sent by DMA, only the last one needs an I2C interrupt
+	if ( entry->writeLen > 0 )
+	{
+		I2C_state = I2C_State_Write;
+		I2C_dmaPos = entry->dataPos;
+		I2C_dmaLeft = entry->writeLen;
+		I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX | I2C_C1_DMAEN;
+		I2C0_D = entry->address;
+		I2C_startTxDMA();
+		return;
+	}
+
+	I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
+
+	// Read only
+	if ( entry->readLen > 0 )
+	{
+		I2C_state = I2C_State_ReadAddress;
+		I2C0_D = entry->address | 0x01;
+		return;
+	}
+
+	// Address only (probe)
+	I2C_state = I2C_State_WriteDone;
+	I2C0_D = entry->address;
+}
+
+// Finishes the active transaction, called from the ISRs
+// stopped is set if a STOP has already been sent
+void I2C_complete( I2C_Status status, uint8_t stopped )
+{
+	I2C_queue[ I2C_queueActive & ( I2C_QueueLength - 1 ) ].status = status;
+	I2C_queueActive++;
+
+	if ( status != I2C_Status_OK )
+		I2C_errors++;
+
+	uint8_t more = I2C_queueActive != I2C_queueTail;
+
+	// Still holding the bus, chain the next transaction with a repeated START
+	if ( !stopped && more )
+	{
+		I2C_start( 1 );
+		return;
+	}
+
+	if ( !stopped )
+	{
+		I2C0_C1 = I2C_C1_IICEN; // Send STOP
+	}
+
+	// Next transaction is started by I2C_process once the STOP has finished
+	I2C_state = I2C_State_Idle;
+	I2C_startPending = more;
+}
+
+// Returns 1 if the given number of transactions and write bytes can be submitted
+uint8_t I2C_available( uint8_t transactions, uint16_t bytes )
+{
+	return (uint8_t)( I2C_queueTail - I2C_queueHead ) + transactions <= I2C_QueueLength
+		&& I2C_dataUsed + bytes <= I2C_DataLength;
+}
+
+uint8_t I2C_pending()
+{
+	return I2C_queueTail != I2C_queueHead;
+}
+
+// Queues a transaction, returns immediately
+// The callback is called from I2C_process once it has finished
+uint8_t I2C_submit( I2C_Transaction *trans )
+{
+	if ( !I2C_available( 1, trans->writeLen ) || ( trans->readLen > 0 && !trans->readData ) )
+	{
+		I2C_queueFull++;
+		return 0;
+	}
+
+	// Copy write bytes
+	uint16_t dataPos = I2C_dataTail;
+	for ( uint16_t c = 0; c < trans->writeLen; c++ )
+	{
+		I2C_data[ I2C_dataTail ] = trans->writeData[ c ];
+		if ( ++I2C_dataTail >= I2C_DataLength )
+			I2C_dataTail = 0;
+	}
+	I2C_dataUsed += trans->writeLen;
+
+	I2C_Entry *entry = &I2C_queue[ I2C_queueTail & ( I2C_QueueLength - 1 ) ];
+	entry->address  = trans->address & 0xFE;
+	entry->readLen  = trans->readLen;
+	entry->readPos  = 0;
+	entry->status   = I2C_Status_OK;
+	entry->writeLen = trans->writeLen;
+	entry->dataPos  = dataPos;
+	entry->readData = trans->readData;
+	entry->callback = trans->callback;
+	entry->context  = trans->context;
+
+	// The ISRs decide whether to chain the next transaction or STOP, keep them out while queuing
+	// Interrupts may already be disabled (scan loop), so the mask is restored rather than enabled
+	uint32_t primask = I2C_irqSave();
+
+	I2C_queueTail++;
+	I2C_transactions++;
+
+	// Bus is idle, start right away unless it's still finishing the last STOP
+	if ( I2C_state == I2C_State_Idle && !I2C_startPending )
+	{
+		if ( I2C0_S & I2C_S_BUSY )
+		{
+			I2C_startPending = 1;
+		}
+		else
+		{
+			I2C_start( 0 );
+		}
+	}
+
+	I2C_irqRestore( primask );
+
+	return 1;
+}
+
+// Starts any transaction waiting for the bus, and calls the callbacks of the finished ones
+// Called from the scan loop
+void I2C_process()
+{
+	uint32_t primask = I2C_irqSave();
+
+	if ( I2C_startPending && I2C_state == I2C_State_Idle && !( I2C0_S & I2C_S_BUSY ) )
+	{
+		I2C_startPending = 0;
+		I2C_start( 0 );
+	}
+
+	I2C_irqRestore( primask );
+
+	// Entries behind I2C_queueActive are no longer used by the ISRs
+	while ( I2C_queueHead != I2C_queueActive )
+	{
+		I2C_Entry *entry = &I2C_queue[ I2C_queueHead & ( I2C_QueueLength - 1 ) ];
+
+		// Free the entry before the callback, so it can submit the next transaction
+		I2C_Callback callback = entry->callback;
+		I2C_Status status = entry->status;
+		uint8_t *data = entry->readData;
+		uint8_t len = entry->readPos;
+		void *context = entry->context;
+
+		I2C_dataUsed -= entry->writeLen;
+		I2C_queueHead++;
+
+		if ( callback )
+			callback( status, data, len, context );
+	}
+}
+
+// Only used during setup, before the scan loop disables interrupts
+void I2C_sync()
+{
+	while ( I2C_pending() )
+		I2C_process();
+}
+
+
+
+// ----- CLI Command Functions -----
+
+void I2C_cliCallback( I2C_Status status, uint8_t *data, uint8_t len, void *context )
+{
+	if ( status != I2C_Status_OK )
+	{
+		warn_msg("I2C transaction failed: ");
+		printHex( status );
+		print( NL );
+		return;
+	}
+
+	for ( uint8_t c = 0; c < len; c++ )
+	{
+		info_msg("I2C Read: ");
+		printHex( data[ c ] );
+		print( NL );
+	}
+}
+
+// Parses the CLI byte sequences, the first byte of each is the address
+// Only the last sequence reads (readLen bytes)
+void I2C_cliSequences( char* args, uint8_t readLen )
+{
+	char* curArgs;
+	char* arg1Ptr;
+	char* arg2Ptr = args;
+
+	// Buffer used after interpretting the args, will be sent to I2C functions
+	uint8_t buffer[ I2C_CLIBufferLength ];
+	uint8_t bufferLen = 0;
+
+	I2C_Transaction trans = { 0, &buffer[1], 0, &I2C_cliRead, 0, I2C_cliCallback, 0 };
+
+	// No \r\n by default after the command is entered
+	print( NL );
+	info_msg("Sending: ");
+
+	// Parse args until a \0 is found
+	while ( 1 )
+	{
+		curArgs = arg2Ptr; // Use the previous 2nd arg pointer to separate the next arg from the list
+		CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+
+		// Stop processing args if no more are found
+		if ( *arg1Ptr == '\0' )
+			break;
+
+		// If | is found, end sequence and start new one
+		if ( *arg1Ptr == '|' )
+		{
+			print("| ");
+			if ( bufferLen > 0 )
+			{
+				trans.address = buffer[0];
+				trans.writeLen = bufferLen - 1;
+				if ( !I2C_submit( &trans ) )
+					break;
+			}
+			bufferLen = 0;
+			continue;
+		}
+
+		// Interpret the argument
+		if ( bufferLen < I2C_CLIBufferLength )
+			buffer[ bufferLen++ ] = (uint8_t)numToInt( arg1Ptr );
+
+		// Print out the arg
+		dPrint( arg1Ptr );
+		print(" ");
+	}
+
+	print( NL );
+
+	if ( bufferLen == 0 )
+		return;
+
+	trans.address = buffer[0];
+	trans.writeLen = bufferLen - 1;
+	trans.readLen = readLen;
+	if ( !I2C_submit( &trans ) )
+	{
+		warn_print("I2C queue full");
+	}
+}
+
+void cliFunc_i2cSend( char* args )
+{
+	I2C_cliSequences( args, 0 );
+}
+
+void cliFunc_i2cRecv( char* args )
+{
+	I2C_cliSequences( args, 1 ); // Only 1 byte is ever read at a time with the ISSI chip
+}
+
+void cliFunc_i2cStats( char* args )
+{
+	print( NL ); // No \r\n by default after the command is entered
+	info_msg("Transactions: ");
+	printInt32( I2C_transactions );
+	print( NL );
+	info_msg("Errors: ");
+	printInt32( I2C_errors );
+	print( NL );
+	info_msg("Queue Full: ");
+	printInt32( I2C_queueFull );
+	print( NL );
+	info_msg("Pending: ");
+	printInt8( (uint8_t)( I2C_queueTail - I2C_queueHead ) );
+	print(" (");
+	printInt16( I2C_dataUsed );
+	print(" bytes)" NL );
+	info_msg("Interrupts: ");
+	printInt32( I2C_interrupts );
+}
+
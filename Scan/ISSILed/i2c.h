@@ -0,0 +1,81 @@
+/* Copyright (C) 2014-2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdint.h>
+
+
+
+// ----- Defines -----
+
+// I2C0 transaction queue
+// Each transaction is a START, the address, the write bytes, then (if reading) a repeated START,
+// the address with the read bit set and the read bytes
+// Queued transactions are chained with repeated STARTs, a STOP is only sent once the queue is empty
+// (or after a read/error, the next transaction then starts once the bus is free)
+#define I2C_QueueLength 16  // Transactions, must be a power of two
+#define I2C_DataLength  300 // Bytes of write data
+
+#if ( I2C_QueueLength & ( I2C_QueueLength - 1 ) ) != 0
+#error "I2C_QueueLength must be a power of two"
+#endif
+
+
+
+// ----- Enums -----
+
+// Transaction result, given to the callback
+typedef enum I2C_Status {
+	I2C_Status_OK,
+	I2C_Status_NAK,             // Address or data byte was not acknowledged
+	I2C_Status_ArbitrationLost, // Another master took the bus
+} I2C_Status;
+
+
+
+// ----- Structs -----
+
+// Called from I2C_process (scan loop, not the ISR) once a transaction has finished
+// data/len are the read bytes (only valid if the status is OK)
+typedef void (*I2C_Callback)( I2C_Status status, uint8_t *data, uint8_t len, void *context );
+
+// Transaction descriptor
+// The write bytes are copied when submitted, the descriptor doesn't need to outlive I2C_submit
+typedef struct I2C_Transaction {
+	uint8_t       address;   // 8 bit (write) address, the read bit is added for the read phase
+	uint8_t      *writeData;
+	uint16_t      writeLen;  // May be 0 for a read only transaction
+	uint8_t      *readData;  // Filled in by the ISR, must stay valid until the callback
+	uint8_t       readLen;
+	I2C_Callback  callback;  // May be 0
+	void         *context;
+} I2C_Transaction;
+
+
+
+// ----- Functions -----
+
+void    I2C_setup();
+uint8_t I2C_submit( I2C_Transaction *trans ); // Returns 0 if there isn't enough room in the queue
+uint8_t I2C_available( uint8_t transactions, uint16_t bytes );
+uint8_t I2C_pending(); // Transactions submitted and not yet completed (callback called)
+void    I2C_process(); // Starts deferred transactions and calls the completion callbacks
+void    I2C_sync();    // Runs the queue until empty, only for use before the scan loop starts
+
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+'''
+Generates the ISSI LED gamma correction table
+'''
+
+# Copyright (C) 2015 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+# Imports
+import argparse
+import sys
+
+
+# Perceived brightness (0 -> 255) to PWM duty cycle (0 -> 255)
+# Anything that isn't off stays at least 1, so the dimmest values don't vanish
+def gamma_table( gamma ):
+	table = []
+	for value in range( 0, 256 ):
+		duty = int( round( 255 * ( value / 255 ) ** gamma ) )
+		if value > 0 and duty == 0:
+			duty = 1
+		table.append( duty )
+
+	return table
+
+
+def header( table, gamma ):
+	output = "// Generated by ledGamma.py, do not edit\n"
+	output += "// Gamma {0}\n\n".format( gamma )
+	output += "#pragma once\n\n"
+	output += "// Perceived brightness to ISSI PWM value, stored in flash\n"
+	output += "const uint8_t LED_gammaTable[] = {\n"
+
+	for row in range( 0, 256, 16 ):
+		output += "\t"
+		output += " ".join( "{0:3},".format( duty ) for duty in table[ row : row + 16 ] )
+		output += "\n"
+
+	output += "};\n\n"
+
+	return output
+
+
+# Main
+parser = argparse.ArgumentParser( description='Generates the ISSI LED gamma correction table' )
+parser.add_argument( 'output', help='Output header' )
+parser.add_argument( '--gamma', type=float, default=2.2, help='Gamma exponent (default: 2.2)' )
+args = parser.parse_args()
+
+if args.gamma <= 0:
+	print( "ERROR: Gamma must be greater than 0, not {0}".format( args.gamma ) )
+	sys.exit( 1 )
+
+with open( args.output, 'w' ) as outfile:
+	outfile.write( header( gamma_table( args.gamma ), args.gamma ) )
+
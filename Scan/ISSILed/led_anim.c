@@ -0,0 +1,148 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <string.h> // for memset()
+
+// Local Includes
+#include "led_anim.h"
+
+
+
+// ----- Variables -----
+
+// Quarter period of a sine wave, sin(x) * 127 for x = 0 -> pi/2
+const uint8_t LED_sineTable[] = {
+	  0,   3,   6,   9,  12,  16,  19,  22,  25,  28,  31,  34,  37,  40,  43,  46,
+	 49,  51,  54,  57,  60,  63,  65,  68,  71,  73,  76,  78,  81,  83,  85,  88,
+	 90,  92,  94,  96,  98, 100, 102, 104, 106, 107, 109, 111, 112, 113, 115, 116,
+	117, 118, 120, 121, 122, 122, 123, 124, 125, 125, 126, 126, 126, 127, 127, 127,
+	127,
+};
+
+uint8_t  LED_animationId = LED_Animation_None;
+uint32_t LED_animationFrame = 0;
+
+// Position of this node's channels in a split keyboard (node id * LED_BufferLength)
+// Animations that move across the channels carry on from one half to the next
+uint16_t LED_animationOffset = 0;
+
+// Next channel to compute in the current frame
+uint8_t  LED_animationChannel = LED_BufferLength;
+uint16_t LED_animationElapsed = 0;
+
+// Reactive brightness of each channel, 8.8 fixed point so slow fades don't stall
+uint16_t LED_animationHeat[ LED_BufferLength ];
+
+
+
+// ----- Functions -----
+
+// 0 -> 255 sine wave, one period over 256 phases (starts at the midpoint, rising)
+uint8_t LED_sine( uint8_t phase )
+{
+	uint8_t pos = phase & 0x3F;
+	switch ( phase >> 6 )
+	{
+	case 0:  return 128 + LED_sineTable[ pos ];
+	case 1:  return 128 + LED_sineTable[ 64 - pos ];
+	case 2:  return 128 - LED_sineTable[ pos ];
+	default: return 128 - LED_sineTable[ 64 - pos ];
+	}
+}
+
+// Switches animation, starting from frame 0
+void LED_animationSelect( uint8_t id )
+{
+	LED_animationId = id < LED_Animation_Count ? id : LED_Animation_None;
+	LED_animationFrame = 0;
+	LED_animationChannel = LED_BufferLength;
+	memset( LED_animationHeat, 0, sizeof( LED_animationHeat ) );
+}
+
+// Lights up a channel (and a little of its neighbours) for the reactive animation
+void LED_animationHit( uint8_t channel )
+{
+	if ( channel >= LED_BufferLength )
+		return;
+
+	LED_animationHeat[ channel ] = 0xFF00;
+
+	if ( channel > 0 && LED_animationHeat[ channel - 1 ] < LED_ReactiveRipple << 8 )
+		LED_animationHeat[ channel - 1 ] = LED_ReactiveRipple << 8;
+	if ( channel + 1 < LED_BufferLength && LED_animationHeat[ channel + 1 ] < LED_ReactiveRipple << 8 )
+		LED_animationHeat[ channel + 1 ] = LED_ReactiveRipple << 8;
+}
+
+// Starts computing the next frame
+// elapsed is the number of frame periods since the last one (more than 1 if frames were skipped)
+// The first frame after LED_animationSelect is started with 0
+void LED_animationBegin( uint16_t elapsed )
+{
+	LED_animationFrame += elapsed;
+	LED_animationElapsed = elapsed < LED_MaxElapsed ? elapsed : LED_MaxElapsed;
+	LED_animationChannel = 0;
+}
+
+// Computes up to the given number of channels of the current frame into frame
+// Returns 1 once every channel has been computed (or if no frame was started)
+uint8_t LED_animationStep( LED_Buffer *frame, uint8_t channels )
+{
+	uint8_t end = LED_animationChannel + channels;
+	if ( end > LED_BufferLength || end < LED_animationChannel )
+		end = LED_BufferLength;
+
+	uint8_t ch = LED_animationChannel;
+	switch ( LED_animationId )
+	{
+	case LED_Animation_Breathe:
+	{
+		uint8_t value = LED_sine( ( LED_animationFrame * LED_BreatheStep ) >> 8 );
+		for ( ; ch < end; ch++ )
+			frame->buffer[ ch ] = value;
+		break;
+	}
+
+	case LED_Animation_Gradient:
+	{
+		uint16_t phase = LED_animationFrame * LED_GradientStep + ( LED_animationOffset + ch ) * LED_GradientSpread;
+		for ( ; ch < end; ch++, phase += LED_GradientSpread )
+			frame->buffer[ ch ] = LED_sine( phase >> 8 );
+		break;
+	}
+
+	case LED_Animation_Reactive:
+		for ( ; ch < end; ch++ )
+		{
+			uint16_t heat = LED_animationHeat[ ch ];
+			for ( uint16_t c = 0; c < LED_animationElapsed; c++ )
+				heat = ( (uint32_t)heat * LED_ReactiveDecay ) >> 8;
+			LED_animationHeat[ ch ] = heat;
+			frame->buffer[ ch ] = heat >> 8;
+		}
+		break;
+
+	default:
+		ch = end;
+		break;
+	}
+
+	LED_animationChannel = ch;
+	return ch >= LED_BufferLength;
+}
+
@@ -0,0 +1,81 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdint.h>
+
+// Local Includes
+#include "led_scan.h"
+
+
+
+// ----- Defines -----
+
+// LED animation engine
+// Frames are computed a few channels at a time (LED_animationStep), so the caller decides how much
+// time each call may take. All of the math is fixed point, and nothing here touches the hardware.
+//
+// Phases are 8.8 fixed point, 256 whole phases is one period of LED_sine
+
+// Breathe, phase advance per frame (0x0200 -> 128 frames per breath)
+#define LED_BreatheStep 0x0200
+
+// Gradient, phase advance per frame and phase difference between neighbouring channels
+#define LED_GradientStep    0x0200
+#define LED_GradientSpread  0x0800
+
+// Reactive, brightness kept per frame after a hit (out of 256), and the brightness of the neighbours
+#define LED_ReactiveDecay   230
+#define LED_ReactiveRipple  128
+
+// Frames of decay applied at once when frames were skipped
+#define LED_MaxElapsed      16
+
+
+
+// ----- Enums -----
+
+typedef enum LED_AnimationId {
+	LED_Animation_None,     // Animations off, LED_pageBuffer is left alone
+	LED_Animation_Breathe,  // All channels fade in and out together
+	LED_Animation_Gradient, // Wave moving across the channels
+	LED_Animation_Reactive, // Channels light up on a hit (LED_animationHit) and fade out
+	LED_Animation_Count,
+} LED_AnimationId;
+
+
+
+// ----- Variables -----
+
+extern uint8_t  LED_animationId;
+extern uint32_t LED_animationFrame; // Frame number being computed
+extern uint16_t LED_animationOffset; // Channel position of this node, for animations spanning split halves
+
+
+
+// ----- Functions -----
+
+uint8_t LED_sine( uint8_t phase );
+
+void    LED_animationSelect( uint8_t id );
+void    LED_animationHit( uint8_t channel );
+void    LED_animationBegin( uint16_t elapsed ); // Starts the next frame, elapsed frames after the last one
+uint8_t LED_animationStep( LED_Buffer *frame, uint8_t channels ); // Returns 1 once the frame is complete
+
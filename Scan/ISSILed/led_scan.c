@@ -18,74 +18,98 @@
 
 // Compiler Includes
 #include <Lib/ScanLib.h>
+#include <string.h> // for memcmp()/memcpy()
 
 // Project Includes
 #include <cli.h>
 #include <led.h>
 #include <print.h>
 #include <led_conf.h> // Located with scan_loop.c
+#include <kll_defs.h>
 
 // Local Includes
+#include "i2c.h"
+#include "led_anim.h"
 #include "led_scan.h"
 
+// Generated Includes
+#include "led_gamma.h" // Generated by ledGamma.py during the build
+
 
 
 // ----- Defines -----
 
-#define I2C_TxBufferLength 300
-#define I2C_RxBufferLength 8
+// ISSI chip I2C address
+#define LED_Address 0xE8
+
+// ISSI frame pages used for double buffering, one is displayed while the other is written
+#define LED_FramePages 2
+
+// Unchanged registers between two changed ones that are cheaper to resend than to start a new write
+// (chip address, start register and the start/stop conditions)
+#define LED_FlushGap 4
+
+// Register ranges sent per frame, leaving room for the page select and display transactions
+// The last range is extended to cover the rest of the changed registers
+#define LED_FlushRanges ( I2C_QueueLength - 3 )
 
-#define LED_BufferLength 144
+// ISSI hardware shutdown (SDB) pin, led_conf.h may set a different one
+#ifndef LED_ShutdownGPIO
+#define LED_ShutdownGPIO GPIOB
+#define LED_ShutdownPCR  PORTB_PCR16
+#define LED_ShutdownPin  16
+#endif
 
+#define LED_gpioReg( gpio, reg )  LED_gpioReg_( gpio, reg )
+#define LED_gpioReg_( gpio, reg ) gpio##_##reg
 
-// ----- Structs -----
+// Animation channels computed between checks of the frame budget
+#define LED_AnimationChunk 16
 
-typedef struct I2C_Buffer {
-	uint16_t  head;
-	uint16_t  tail;
-	uint8_t   sequencePos;
-	uint16_t  size;
-	uint8_t  *buffer;
-} I2C_Buffer;
+// Highest frame rate, frame periods are whole milliseconds
+#define LED_FrameRateMax 1000
 
-typedef struct LED_Buffer {
-	uint8_t buffer[LED_BufferLength];
-} LED_Buffer;
+#if LEDFrameRate_define < 1 || LEDFrameRate_define > LED_FrameRateMax
+#error "LEDFrameRate must be between 1 and 1000"
+#endif
+
+// Animation sync params, [animation id, frame number (4 bytes, LSB first), frame rate (2 bytes, LSB first)]
+#define LED_SyncLength 7
 
 
 
 // ----- Function Declarations -----
 
 // CLI Functions
-void cliFunc_i2cRecv( char* args );
-void cliFunc_i2cSend( char* args );
+void cliFunc_ledAnim( char* args );
+void cliFunc_ledBright( char* args );
 void cliFunc_ledPage( char* args );
 void cliFunc_ledStart( char* args );
+void cliFunc_ledStats( char* args );
 void cliFunc_ledTest( char* args );
 void cliFunc_ledZero( char* args );
 
-uint8_t I2C_TxBufferPop();
-void I2C_BufferPush( uint8_t byte, I2C_Buffer *buffer );
-uint16_t I2C_BufferLen( I2C_Buffer *buffer );
-uint8_t I2C_Send( uint8_t *data, uint8_t sendLen, uint8_t recvLen );
+void LED_readCallback( I2C_Status status, uint8_t *data, uint8_t len, void *context );
 
 
 
 // ----- Variables -----
 
 // Scan Module command dictionary
-CLIDict_Entry( i2cRecv,     "Send I2C sequence of bytes and expect a reply of 1 byte on the last sequence." NL "\t\tUse |'s to split sequences with a stop." );
-CLIDict_Entry( i2cSend,     "Send I2C sequence of bytes. Use |'s to split sequences with a stop." );
+CLIDict_Entry( ledAnim,     "Show animation statistics. Optionally select an animation (and frame rate)." NL "\t\t0 - Off, 1 - Breathe, 2 - Gradient, 3 - Reactive" );
+CLIDict_Entry( ledBright,   "Show the LED brightness. Optionally set it (0 -> 255)." );
 CLIDict_Entry( ledPage,     "Read the given register page." );
 CLIDict_Entry( ledStart,    "Disable software shutdown." );
+CLIDict_Entry( ledStats,    "Show LED frame flush statistics." );
 CLIDict_Entry( ledTest,     "Test out the led pages." );
 CLIDict_Entry( ledZero,     "Zero out LED register pages (non-configuration)." );
 
 CLIDict_Def( ledCLIDict, "ISSI LED Module Commands" ) = {
-	CLIDict_Item( i2cRecv ),
-	CLIDict_Item( i2cSend ),
+	CLIDict_Item( ledAnim ),
+	CLIDict_Item( ledBright ),
 	CLIDict_Item( ledPage ),
 	CLIDict_Item( ledStart ),
+	CLIDict_Item( ledStats ),
 	CLIDict_Item( ledTest ),
 	CLIDict_Item( ledZero ),
 	{ 0, 0, 0 } // Null entry for dictionary end
@@ -93,16 +117,60 @@ CLIDict_Def( ledCLIDict, "ISSI LED Module Commands" ) = {
 
 
 
-// Before sending the sequence, I2C_TxBuffer_CurLen is assigned and as each byte is sent, it is decremented
-// Once I2C_TxBuffer_CurLen reaches zero, a STOP on the I2C bus is sent
-volatile uint8_t I2C_TxBufferPtr[ I2C_TxBufferLength ];
-volatile uint8_t I2C_RxBufferPtr[ I2C_TxBufferLength ];
-
-volatile I2C_Buffer I2C_TxBuffer = { 0, 0, 0, I2C_TxBufferLength, (uint8_t*)I2C_TxBufferPtr };
-volatile I2C_Buffer I2C_RxBuffer = { 0, 0, 0, I2C_RxBufferLength, (uint8_t*)I2C_RxBufferPtr };
-
+// Back buffer, effects write PWM values here at any time
+// LED_scan sends the changes to the frame page that isn't displayed, then switches the displayed page
 LED_Buffer LED_pageBuffer;
 
+// What each of the ISSI frame pages currently holds, so only the changed registers are sent
+LED_Buffer LED_pageShadow[ LED_FramePages ];
+uint8_t    LED_displayPage = 0;
+
+// Back buffer values are perceived brightness, each is mapped to a PWM value while flushing
+// LED_outputTable is the gamma table (flash) scaled by the global brightness, only rebuilt when it changes
+uint8_t    LED_brightness = LEDBrightness_define;
+uint8_t    LED_outputTable[ 256 ];
+LED_Buffer LED_outputBuffer;
+LED_Buffer LED_flushedBuffer;   // Back buffer as of the last flush
+uint8_t    LED_flushForce = 0;  // Flush even if the back buffer hasn't changed (new brightness)
+
+// Flush statistics
+uint32_t LED_flushFrames = 0;
+uint32_t LED_flushBytes = 0;
+
+// Animation frame clock
+// A frame is started every 1000 / LED_frameRate ms, and computed into LED_animationBuffer over as many
+// scan loops as it takes, spending at most LED_frameBudget us per loop. Then it's copied to the back buffer.
+uint16_t   LED_frameRate = LEDFrameRate_define;
+uint16_t   LED_frameBudget = LEDFrameBudget_define;
+uint32_t   LED_frameDue = 0;
+uint8_t    LED_frameBusy = 0;  // Frame being computed
+uint8_t    LED_frameFirst = 0; // Next frame is the first one after selecting the animation
+LED_Buffer LED_animationBuffer;
+
+// Animation statistics
+uint32_t LED_frameCycles = 0;     // Spent on the frame being computed
+uint32_t LED_frameCyclesLast = 0;
+uint32_t LED_frameCyclesMax = 0;
+uint32_t LED_framesComputed = 0;
+uint32_t LED_framesDropped = 0;   // Frame periods skipped, or frames replaced before being sent
+
+// Split keyboard animation sync (UARTConnect Animation command)
+// The master sends its frame clock when the animation changes and every LED_syncInterval frames after that,
+// each slave takes it over at the start of its next frame and renders the same frame numbers locally
+uint16_t LED_syncInterval = LEDSyncInterval_define;
+uint8_t  LED_syncDue = 0;       // Master, a frame started that should be sent
+uint32_t LED_syncFrame = 0;     // Master, frame number last sent
+uint8_t  LED_syncPending = 0;   // Slave, sync received and not yet applied
+uint8_t  LED_syncParams[ LED_SyncLength ];
+uint32_t LED_syncTime = 0;      // Slave, when the pending sync was received (ms)
+uint32_t LED_syncsSent = 0;
+uint32_t LED_syncsApplied = 0;
+
+// ledPage register read, one register per transaction
+uint8_t LED_readReg = 0;
+uint8_t LED_readLen = 0;
+uint8_t LED_readValue;
+
 /*
 // A bit mask determining which LEDs are enabled in the ISSI chip
 // All channel mask example
@@ -193,235 +261,105 @@ const uint8_t examplePage[] = {
 
 
 
-// ----- Interrupt Functions -----
+// ----- Functions -----
 
-void i2c0_isr()
+// Queues a register write sequence (chip address first), returns 0 if the I2C queue is full
+uint8_t LED_write( uint8_t *data, uint16_t len )
 {
-	cli(); // Disable Interrupts
-
-	uint8_t status = I2C0_S; // Read I2C Bus status
-
-	// Master Mode Transmit
-	if ( I2C0_C1 & I2C_C1_TX )
-	{
-		// Check current use of the I2C bus
-		// Currently sending data
-		if ( I2C_TxBuffer.sequencePos > 0 )
-		{
-			// Make sure slave sent an ACK
-			if ( status & I2C_S_RXAK )
-			{
-				// NACK Detected, disable interrupt
-				erro_print("I2C NAK detected...");
-				I2C0_C1 = I2C_C1_IICEN;
-
-				// Abort Tx Buffer
-				I2C_TxBuffer.head = 0;
-				I2C_TxBuffer.tail = 0;
-				I2C_TxBuffer.sequencePos = 0;
-			}
-			else
-			{
-				// Transmit byte
-				I2C0_D = I2C_TxBufferPop();
-			}
-		}
-		// Receiving data
-		else if ( I2C_RxBuffer.sequencePos > 0 )
-		{
-			// Master Receive, addr sent
-			if ( status & I2C_S_ARBL )
-			{
-				// Arbitration Lost
-				erro_print("Arbitration lost...");
-				// TODO Abort Rx
-
-				I2C0_C1 = I2C_C1_IICEN;
-				I2C0_S = I2C_S_ARBL | I2C_S_IICIF; // Clear ARBL flag and interrupt
-			}
-			if ( status & I2C_S_RXAK )
-			{
-				// Slave Address NACK Detected, disable interrupt
-				erro_print("Slave Address I2C NAK detected...");
-				// TODO Abort Rx
-
-				I2C0_C1 = I2C_C1_IICEN;
-			}
-			else
-			{
-				dbug_print("Attempting to read byte");
-				I2C0_C1 = I2C_RxBuffer.sequencePos == 1
-					? I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK // Single byte read
-					: I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST; // Multi-byte read
-			}
-		}
-		else
-		{
-			/*
-			dbug_msg("STOP - ");
-			printHex( I2C_BufferLen( (I2C_Buffer*)&I2C_TxBuffer ) );
-			print(NL);
-			*/
-
-			// Delay around STOP to make sure it actually happens...
-			delayMicroseconds( 1 );
-			I2C0_C1 = I2C_C1_IICEN; // Send STOP
-			delayMicroseconds( 7 );
-
-			// If there is another sequence, start sending
-			if ( I2C_BufferLen( (I2C_Buffer*)&I2C_TxBuffer ) < I2C_TxBuffer.size )
-			{
-				// Clear status flags
-				I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
-
-				// Wait...till the master dies
-				while ( I2C0_S & I2C_S_BUSY );
-
-				// Enable I2C interrupt
-				I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
-
-				// Transmit byte
-				I2C0_D = I2C_TxBufferPop();
-			}
-		}
-	}
-	// Master Mode Receive
-	else
-	{
-		// XXX Do we need to handle 2nd last byte?
-		//I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TXAK; // No STOP, Rx, NAK on recv
-
-		// Last byte
-		if ( I2C_TxBuffer.sequencePos <= 1 )
-		{
-			// Change to Tx mode
-			I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX;
-
-			// Grab last byte
-			I2C_BufferPush( I2C0_D, (I2C_Buffer*)&I2C_RxBuffer );
-
-			delayMicroseconds( 1 ); // Should be enough time before issuing the stop
-			I2C0_C1 = I2C_C1_IICEN; // Send STOP
-		}
-		else
-		{
-			// Retrieve data
-			I2C_BufferPush( I2C0_D, (I2C_Buffer*)&I2C_RxBuffer );
-		}
-	}
-
-	I2C0_S = I2C_S_IICIF; // Clear interrupt
-
-	sei(); // Re-enable Interrupts
+	I2C_Transaction trans = { data[0], &data[1], len - 1, 0, 0, 0, 0 };
+	return I2C_submit( &trans );
 }
 
+// Queues a page select followed by a register write sequence
+uint8_t LED_writePage( uint8_t *data, uint16_t len, uint8_t page )
+{
+	// Page Setup
+	uint8_t pageSetup[] = { LED_Address, 0xFD, page };
 
+	// Both or neither, so the write never lands on the wrong page
+	if ( !I2C_available( 2, sizeof( pageSetup ) - 1 + len - 1 ) )
+		return 0;
 
-// ----- Functions -----
-
-inline void I2C_setup()
-{
-	// Enable I2C internal clock
-	SIM_SCGC4 |= SIM_SCGC4_I2C0; // Bus 0
-
-	// External pull-up resistor
-	PORTB_PCR0 = PORT_PCR_ODE | PORT_PCR_SRE | PORT_PCR_DSE | PORT_PCR_MUX(2);
-	PORTB_PCR1 = PORT_PCR_ODE | PORT_PCR_SRE | PORT_PCR_DSE | PORT_PCR_MUX(2);
-
-	// SCL Frequency Divider
-	// 400kHz -> 120 (0x85) @ 48 MHz F_BUS
-	I2C0_F = 0x85;
-	I2C0_FLT = 4;
-	I2C0_C1 = I2C_C1_IICEN;
-	I2C0_C2 = I2C_C2_HDRS; // High drive select
-
-	// Enable I2C Interrupt
-	NVIC_ENABLE_IRQ( IRQ_I2C0 );
+	LED_write( pageSetup, sizeof( pageSetup ) );
+	LED_write( data, len );
+	return 1;
 }
 
+// Only used during setup, waits for each page to be sent
 void LED_zeroPages( uint8_t startPage, uint8_t numPages, uint8_t startReg, uint8_t endReg )
 {
-	// Page Setup
-	uint8_t pageSetup[] = { 0xE8, 0xFD, 0x00 };
-
 	// Max length of a page + chip id + reg start
 	uint8_t fullPage[ 0xB4 + 2 ] = { 0 }; // Max size of page
-	fullPage[0] = 0xE8;     // Set chip id
-	fullPage[1] = startReg; // Set start reg
+	fullPage[0] = LED_Address; // Set chip id
+	fullPage[1] = startReg;    // Set start reg
 
 	// Iterate through given pages, zero'ing out the given register regions
 	for ( uint8_t page = startPage; page < startPage + numPages; page++ )
 	{
-		// Set page
-		pageSetup[2] = page;
-
-		// Setup page
-		while ( I2C_Send( pageSetup, sizeof( pageSetup ), 0 ) == 0 )
-			delay(1);
-
-		// Zero out page
-		while ( I2C_Send( fullPage, endReg - startReg + 2, 0 ) == 0 )
-			delay(1);
+		LED_writePage( fullPage, endReg - startReg + 2, page );
+		I2C_sync();
 	}
 }
 
-void LED_sendPage( uint8_t *buffer, uint8_t len, uint8_t page )
+uint8_t LED_sendPage( uint8_t *buffer, uint8_t len, uint8_t page )
 {
-	// Page Setup
-	uint8_t pageSetup[] = { 0xE8, 0xFD, page };
-
-	// Setup page
-	while ( I2C_Send( pageSetup, sizeof( pageSetup ), 0 ) == 0 )
-		delay(1);
-
-	// Write page to I2C Tx Buffer
-	while ( I2C_Send( buffer, len, 0 ) == 0 )
-		delay(1);
-
+	return LED_writePage( buffer, len, page );
 }
 
-void LED_readPage( uint8_t len, uint8_t page )
+// Reads the given number of registers from the page, printing each as it arrives
+// The next register is requested from the callback of the previous one
+uint8_t LED_readPage( uint8_t len, uint8_t page )
 {
-	// Page Setup
-	uint8_t pageSetup[] = { 0xE8, 0xFD, page };
+	// Previous read still running
+	if ( LED_readReg < LED_readLen )
+		return 0;
 
-	// Setup page
-	while ( I2C_Send( pageSetup, sizeof( pageSetup ), 0 ) == 0 )
-		delay(1);
+	// Page Setup
+	uint8_t pageSetup[] = { LED_Address, 0xFD, page };
+	if ( !LED_write( pageSetup, sizeof( pageSetup ) ) )
+		return 0;
 
-	// Register Setup
-	uint8_t regSetup[] = { 0xE8, 0x00 };
+	LED_readReg = 0;
+	LED_readLen = len;
+	LED_readCallback( I2C_Status_OK, 0, 0, 0 );
+	return 1;
+}
 
-	// Setup starting register
-	while ( I2C_Send( regSetup, sizeof( regSetup ), 0 ) == 0 )
-		delay(1);
+void LED_readCallback( I2C_Status status, uint8_t *data, uint8_t len, void *context )
+{
+	// Print the register that was just read
+	if ( data )
+	{
+		if ( LED_readReg % 16 == 0 )
+			print( NL );
+		printHex( status == I2C_Status_OK && len == 1 ? *data : 0xFF );
+		print(" ");
+		LED_readReg++;
+	}
 
-	// Register Read Command
-	uint8_t regReadCmd[] = { 0xE9 };
+	// Finished
+	if ( LED_readReg >= LED_readLen )
+	{
+		print( NL );
+		return;
+	}
 
-	// Read each register in the page
-	for ( uint8_t reg = 0; reg < len; reg++ )
+	// Write the register address, then read it back with a repeated START
+	uint8_t reg = LED_readReg;
+	I2C_Transaction trans = { LED_Address, &reg, 1, &LED_readValue, 1, LED_readCallback, 0 };
+	if ( !I2C_submit( &trans ) )
 	{
-		// Request register data
-		while ( I2C_Send( regReadCmd, sizeof( regReadCmd ), 0 ) == 0 )
-			delay(1);
+		warn_print("I2C queue full, read aborted");
+		LED_readLen = LED_readReg;
 	}
 }
 
-void LED_writeReg( uint8_t reg, uint8_t val, uint8_t page )
+uint8_t LED_writeReg( uint8_t reg, uint8_t val, uint8_t page )
 {
-	// Page Setup
-	uint8_t pageSetup[] = { 0xE8, 0xFD, page };
-
 	// Reg Write Setup
-	uint8_t writeData[] = { 0xE8, reg, val };
+	uint8_t writeData[] = { LED_Address, reg, val };
 
-	// Setup page
-	while ( I2C_Send( pageSetup, sizeof( pageSetup ), 0 ) == 0 )
-		delay(1);
-
-	while ( I2C_Send( writeData, sizeof( writeData ), 0 ) == 0 )
-		delay(1);
+	return LED_writePage( writeData, sizeof( writeData ), page );
 }
 
 // Setup
@@ -438,351 +376,416 @@ inline void LED_setup()
 	LED_zeroPages( 0x0B, 1, 0x00, 0x0C ); // Control Registers
 
 	// Disable Hardware shutdown of ISSI chip (pull high)
-	GPIOB_PDDR |= (1<<16);
-	PORTB_PCR16 = PORT_PCR_SRE | PORT_PCR_DSE | PORT_PCR_MUX(1);
-	GPIOB_PSOR |= (1<<16);
+	LED_gpioReg( LED_ShutdownGPIO, PDDR ) |= (1 << LED_ShutdownPin);
+	LED_ShutdownPCR = PORT_PCR_SRE | PORT_PCR_DSE | PORT_PCR_MUX(1);
+	LED_gpioReg( LED_ShutdownGPIO, PSOR ) |= (1 << LED_ShutdownPin);
 
 	// Clear LED Pages
 	LED_zeroPages( 0x00, 8, 0x00, 0xB4 ); // LED Registers
 
-	// Enable LEDs based upon mask
-	LED_sendPage( (uint8_t*)LED_ledEnableMask, sizeof( LED_ledEnableMask ), 0 );
+	// Enable LEDs based upon mask, on each of the double buffered frame pages
+	for ( uint8_t page = 0; page < LED_FramePages; page++ )
+	{
+		LED_sendPage( (uint8_t*)LED_ledEnableMask, sizeof( LED_ledEnableMask ), page );
+		I2C_sync();
+	}
+
+	// Pages were cleared, start displaying the first
+	memset( &LED_pageBuffer, 0, sizeof( LED_pageBuffer ) );
+	memset( &LED_flushedBuffer, 0, sizeof( LED_flushedBuffer ) );
+	memset( LED_pageShadow, 0, sizeof( LED_pageShadow ) );
+	LED_displayPage = 0;
+	LED_setBrightness( LED_brightness );
 
 	// Disable Software shutdown of ISSI chip
 	LED_writeReg( 0x0A, 0x01, 0x0B );
+	I2C_sync();
+
+	// Cycle counter, used for the animation frame budget
+	ARM_DEMCR |= ARM_DEMCR_TRCENA;
+	ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
 }
 
+// Sets the global brightness, applied to every LED from the next LED_scan
+void LED_setBrightness( uint8_t brightness )
+{
+	LED_brightness = brightness;
+	for ( uint16_t value = 0; value < 256; value++ )
+		LED_outputTable[ value ] = LED_gammaTable[ ( value * brightness + 127 ) / 255 ];
+
+	LED_flushForce = 1;
+}
 
-inline uint8_t I2C_BufferCopy( uint8_t *data, uint8_t sendLen, uint8_t recvLen, I2C_Buffer *buffer )
+// Switches animation, the first frame is computed on the next LED_scan
+void LED_selectAnimation( uint8_t id )
 {
-	uint8_t reTurn = 0;
+	LED_animationSelect( id );
+	LED_frameBusy = 0;
+	LED_frameFirst = 1;
+	LED_frameDue = millis();
+	LED_frameCyclesMax = 0;
+
+	// Animations off, blank the LEDs
+	// (otherwise the sync is sent once the first frame starts)
+	if ( LED_animationId == LED_Animation_None )
+	{
+		memset( &LED_pageBuffer, 0, sizeof( LED_pageBuffer ) );
+		LED_syncDue = 1;
+	}
+}
 
-	// If sendLen is greater than buffer fail right away
-	if ( sendLen > buffer->size )
+// Master, fills in params with the frame clock if a sync is due
+// Returns the number of params, 0 if there is nothing to send
+uint8_t LED_animationSyncEncode( uint8_t *params )
+{
+	if ( !LED_syncDue )
 		return 0;
+	LED_syncDue = 0;
+
+	params[0] = LED_animationId;
+	params[1] = LED_animationFrame;
+	params[2] = LED_animationFrame >> 8;
+	params[3] = LED_animationFrame >> 16;
+	params[4] = LED_animationFrame >> 24;
+	params[5] = LED_frameRate;
+	params[6] = LED_frameRate >> 8;
+
+	LED_syncsSent++;
+	return LED_SyncLength;
+}
+
+// Slave, frame clock received from the master
+// id is the id of this node, used to carry animations across the halves
+// Applied by LED_animationScan once the frame being computed is finished, so a frame is never torn
+void LED_animationSyncApply( uint8_t *params, uint8_t numParams, uint8_t id )
+{
+	if ( numParams < LED_SyncLength )
+		return;
 
-	// Calculate new tail to determine if buffer has enough space
-	// The first element specifies the expected number of bytes from the slave (+1)
-	// The second element in the new buffer is the length of the buffer sequence (+1)
-	uint16_t newTail = buffer->tail + sendLen + 2;
-	if ( newTail >= buffer->size )
-		newTail -= buffer->size;
+	if ( id != 0xFF )
+		LED_animationOffset = id * LED_BufferLength;
 
-	if ( I2C_BufferLen( buffer ) < sendLen + 2 )
-		return 0;
+	memcpy( LED_syncParams, params, LED_SyncLength );
+	LED_syncTime = millis();
+	LED_syncPending = 1;
+}
 
-/*
-	print("|");
-	printHex( sendLen + 2 );
-	print("|");
-	printHex( *tail );
-	print("@");
-	printHex( newTail );
-	print("@");
-*/
+// Takes over the master's frame clock
+// The master started the frame in the sync at about LED_syncTime (the link only adds around a ms)
+void LED_animationSyncTake( uint32_t now )
+{
+	LED_syncPending = 0;
 
-	// If buffer is clean, return 1, otherwise 2
-	reTurn = buffer->head == buffer->tail ? 1 : 2;
+	uint8_t  id    = LED_syncParams[0];
+	uint32_t frame = LED_syncParams[1] | LED_syncParams[2] << 8 | LED_syncParams[3] << 16 | (uint32_t)LED_syncParams[4] << 24;
+	uint16_t rate  = LED_syncParams[5] | LED_syncParams[6] << 8;
+	if ( rate == 0 )
+		return;
+
+	LED_frameRate = rate > LED_FrameRateMax ? LED_FrameRateMax : rate;
+	if ( id != LED_animationId )
+		LED_selectAnimation( id );
+
+	if ( LED_animationId == LED_Animation_None )
+		return;
+
+	// Frames the master has started since the sync was received, the latest one is due now
+	// (LED_animationBegin adds the elapsed frame back on)
+	uint32_t period = 1000 / LED_frameRate;
+	uint32_t behind = ( now - LED_syncTime ) / period;
+	LED_animationFrame = frame + behind - 1;
+	LED_frameDue = LED_syncTime + behind * period;
+	LED_frameFirst = 0;
+
+	LED_syncsApplied++;
+}
 
-	// Add to buffer, already know there is enough room (simplifies adding logic)
-	uint8_t bufferHeaderPos = 0;
-	for ( uint16_t c = 0; c < sendLen; c++ )
+// Computes animation frames within the frame budget
+void LED_animationScan()
+{
+	// Frame clock from the master, between frames
+	if ( LED_syncPending && !LED_frameBusy )
+		LED_animationSyncTake( millis() );
+
+	if ( LED_animationId == LED_Animation_None )
+		return;
+
+	// Start the next frame once it's due
+	if ( !LED_frameBusy )
 	{
-		// Add data to buffer
-		switch ( bufferHeaderPos )
-		{
-		case 0:
-			buffer->buffer[ buffer->tail ] = recvLen;
-			bufferHeaderPos++;
-			c--;
-			break;
-
-		case 1:
-			buffer->buffer[ buffer->tail ] = sendLen;
-			bufferHeaderPos++;
-			c--;
-			break;
-
-		default:
-			buffer->buffer[ buffer->tail ] = data[ c ];
-			break;
-		}
+		uint32_t now = millis();
+		if ( (int32_t)( now - LED_frameDue ) < 0 )
+			return;
+
+		// Frame periods that went by while the last frame was being computed or sent are skipped,
+		// the animation time still moves on by all of them
+		uint32_t period = 1000 / LED_frameRate;
+		uint32_t elapsed = ( now - LED_frameDue ) / period + 1;
+		LED_frameDue += elapsed * period;
 
-		// Check for wrap-around case
-		if ( buffer->tail + 1 >= buffer->size )
+		if ( LED_frameFirst )
 		{
-			buffer->tail = 0;
+			LED_frameFirst = 0;
+			LED_animationBegin( 0 );
 		}
-		// Normal case
 		else
 		{
-			buffer->tail++;
+			LED_framesDropped += elapsed - 1;
+			LED_animationBegin( elapsed < 0xFFFF ? elapsed : 0xFFFF );
 		}
-	}
-
-	return reTurn;
-}
-
 
-inline uint16_t I2C_BufferLen( I2C_Buffer *buffer )
-{
-	// Tail >= Head
-	if ( buffer->tail >= buffer->head )
-		return buffer->head + buffer->size - buffer->tail;
-
-	// Head > Tail
-	return buffer->head - buffer->tail;
-}
+		// Master, send the frame clock for the first frame, then every LED_syncInterval frames
+		if ( LED_animationFrame == 0 || LED_animationFrame - LED_syncFrame >= LED_syncInterval )
+		{
+			LED_syncFrame = LED_animationFrame;
+			LED_syncDue = 1;
+		}
 
+		LED_frameBusy = 1;
+		LED_frameCycles = 0;
+	}
 
-void I2C_BufferPush( uint8_t byte, I2C_Buffer *buffer )
-{
-	dbug_msg("DATA: ");
-	printHex( byte );
+	// Compute channels until the budget for this scan loop is used up
+	uint32_t start = ARM_DWT_CYCCNT;
+	uint32_t budget = LED_frameBudget * ( F_CPU / 1000000 );
+	uint8_t done;
+	do {
+		done = LED_animationStep( &LED_animationBuffer, LED_AnimationChunk );
+	} while ( !done && ARM_DWT_CYCCNT - start < budget );
+	LED_frameCycles += ARM_DWT_CYCCNT - start;
 
-	// Make sure buffer isn't full
-	if ( buffer->tail + 1 == buffer->head || ( buffer->head > buffer->tail && buffer->tail + 1 - buffer->size == buffer->head ) )
-	{
-		warn_msg("I2C_BufferPush failed, buffer full: ");
-		printHex( byte );
-		print( NL );
+	if ( !done )
 		return;
-	}
 
-	// Check for wrap-around case
-	if ( buffer->tail + 1 >= buffer->size )
-	{
-		buffer->tail = 0;
-	}
-	// Normal case
-	else
-	{
-		buffer->tail++;
-	}
+	// Previous frame never made it to the LEDs
+	if ( memcmp( &LED_pageBuffer, &LED_flushedBuffer, sizeof( LED_Buffer ) ) != 0 )
+		LED_framesDropped++;
 
-	// Add byte to buffer
-	buffer->buffer[ buffer->tail ] = byte;
+	memcpy( &LED_pageBuffer, &LED_animationBuffer, sizeof( LED_Buffer ) );
+
+	LED_frameBusy = 0;
+	LED_framesComputed++;
+	LED_frameCyclesLast = LED_frameCycles;
+	if ( LED_frameCycles > LED_frameCyclesMax )
+		LED_frameCyclesMax = LED_frameCycles;
 }
 
 
-uint8_t I2C_TxBufferPop()
+
+// LED State processing loop
+// Sends the registers that changed in the back buffer to the hidden frame page, then displays it
+// Switching the displayed page is a single register write, so a frame is never shown half written
+inline uint8_t LED_scan()
 {
-	// Return 0xFF if no buffer left (do not rely on this)
-	if ( I2C_BufferLen( (I2C_Buffer*)&I2C_TxBuffer ) >= I2C_TxBuffer.size )
-	{
-		erro_msg("No buffer to pop an entry from... ");
-		printHex( I2C_TxBuffer.head );
-		print(" ");
-		printHex( I2C_TxBuffer.tail );
-		print(" ");
-		printHex( I2C_TxBuffer.sequencePos );
-		print(NL);
-		return 0xFF;
-	}
+	// Start any I2C transaction waiting for the bus, and finish the completed ones
+	I2C_process();
 
-	// If there is currently no sequence being sent, the first entry in the RingBuffer is the length
-	if ( I2C_TxBuffer.sequencePos == 0 )
-	{
-		I2C_TxBuffer.sequencePos = 0xFF; // So this doesn't become an infinite loop
-		I2C_RxBuffer.sequencePos = I2C_TxBufferPop();
-		I2C_TxBuffer.sequencePos = I2C_TxBufferPop();
-	}
+	// Animation frame, at most LED_frameBudget us per call
+	LED_animationScan();
 
-	uint8_t data = I2C_TxBuffer.buffer[ I2C_TxBuffer.head ];
-
-	// Prune head
-	I2C_TxBuffer.head++;
-
-	// Wrap-around case
-	if ( I2C_TxBuffer.head >= I2C_TxBuffer.size )
-		I2C_TxBuffer.head = 0;
-
-	// Decrement buffer sequence (until next stop will be sent)
-	I2C_TxBuffer.sequencePos--;
-
-	/*
-	dbug_msg("Popping: ");
-	printHex( data );
-	print(" ");
-	printHex( I2C_TxBuffer.head );
-	print(" ");
-	printHex( I2C_TxBuffer.tail );
-	print(" ");
-	printHex( I2C_TxBuffer.sequencePos );
-	print(NL);
-	*/
-	return data;
-}
+	// Previous frame is still being sent
+	if ( I2C_pending() )
+		return 0;
 
+	// Nothing has changed since the displayed frame
+	if ( !LED_flushForce && memcmp( &LED_pageBuffer, &LED_flushedBuffer, sizeof( LED_Buffer ) ) == 0 )
+		return 0;
+	LED_flushForce = 0;
 
-uint8_t I2C_Send( uint8_t *data, uint8_t sendLen, uint8_t recvLen )
-{
-	// Check head and tail pointers
-	// If full, return 0
-	// If empty, start up I2C Master Tx
-	// If buffer is non-empty and non-full, just append to the buffer
-	switch ( I2C_BufferCopy( data, sendLen, recvLen, (I2C_Buffer*)&I2C_TxBuffer ) )
-	{
-	// Not enough buffer space...
-	case 0:
-		/*
-		erro_msg("Not enough Tx buffer space... ");
-		printHex( I2C_TxBuffer.head );
-		print(":");
-		printHex( I2C_TxBuffer.tail );
-		print("+");
-		printHex( sendLen );
-		print("|");
-		printHex( I2C_TxBuffer.size );
-		print( NL );
-		*/
+	// Gamma and brightness, one lookup per LED
+	memcpy( &LED_flushedBuffer, &LED_pageBuffer, sizeof( LED_Buffer ) );
+	for ( uint8_t ch = 0; ch < LED_BufferLength; ch++ )
+		LED_outputBuffer.buffer[ ch ] = LED_outputTable[ LED_flushedBuffer.buffer[ ch ] ];
+
+	// A brightness change may not change any of the PWM values
+	if ( memcmp( &LED_outputBuffer, &LED_pageShadow[ LED_displayPage ], sizeof( LED_Buffer ) ) == 0 )
 		return 0;
 
-	// Empty buffer, initialize I2C
-	case 1:
-		// Clear status flags
-		I2C0_S = I2C_S_IICIF | I2C_S_ARBL;
+	uint8_t page = LED_displayPage ^ 1;
+	LED_Buffer *shadow = &LED_pageShadow[ page ];
 
-		// Check to see if we already have control of the bus
-		if ( I2C0_C1 & I2C_C1_MST )
+	// Page Setup
+	// The queue is empty, and a full frame (LED_FlushRanges ranges, every register) always fits
+	uint8_t pageSetup[] = { LED_Address, 0xFD, page };
+	LED_write( pageSetup, sizeof( pageSetup ) );
+
+	// End of the changed registers, the final range runs up to it
+	// The hidden page may already hold this frame, then only the displayed page is switched
+	uint8_t end = LED_BufferLength;
+	while ( end > 0 && LED_outputBuffer.buffer[ end - 1 ] == shadow->buffer[ end - 1 ] )
+		end--;
+
+	// Send each changed register range, PWM registers start at 0x24
+	uint8_t regWrite[ LED_BufferLength + 2 ];
+	regWrite[0] = LED_Address;
+	uint8_t reg = 0;
+	uint8_t ranges = 0;
+	while ( reg < end )
+	{
+		if ( LED_outputBuffer.buffer[ reg ] == shadow->buffer[ reg ] )
 		{
-			// Already the master (ah yeah), send a repeated start
-			I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_RSTA | I2C_C1_TX;
+			reg++;
+			continue;
+		}
+
+		// Extend the range until there's a long enough run of unchanged registers
+		uint8_t last = reg;
+		if ( ++ranges == LED_FlushRanges )
+		{
+			last = end - 1;
 		}
-		// Otherwise, seize control
 		else
 		{
-			// Wait...till the master dies
-			while ( I2C0_S & I2C_S_BUSY );
-
-			// Now we're the master (ah yisss), get ready to send stuffs
-			I2C0_C1 = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX;
+			for ( uint8_t pos = reg + 1; pos < end && pos - last <= LED_FlushGap; pos++ )
+			{
+				if ( LED_outputBuffer.buffer[ pos ] != shadow->buffer[ pos ] )
+					last = pos;
+			}
 		}
 
-		// Enable I2C interrupt
-		I2C0_C1 = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX;
+		uint8_t len = last - reg + 1;
+		regWrite[1] = 0x24 + reg;
+		memcpy( &regWrite[2], &LED_outputBuffer.buffer[ reg ], len );
+		memcpy( &shadow->buffer[ reg ], &LED_outputBuffer.buffer[ reg ], len );
+		LED_write( regWrite, len + 2 );
 
-		// Depending on what type of transfer, the first byte is configured for R or W
-		I2C0_D = I2C_TxBufferPop();
-
-		return 1;
+		LED_flushBytes += len + 2;
+		reg = last + 1;
 	}
 
-	// Dirty buffer, I2C already initialized
-	return 2;
+	// Display the page (Picture Display register of the Function Register page)
+	uint8_t functionSetup[] = { LED_Address, 0xFD, 0x0B };
+	uint8_t displayWrite[] = { LED_Address, 0x01, page };
+	LED_write( functionSetup, sizeof( functionSetup ) );
+	LED_write( displayWrite, sizeof( displayWrite ) );
+
+	LED_displayPage = page;
+	LED_flushFrames++;
+	LED_flushBytes += sizeof( pageSetup ) + sizeof( functionSetup ) + sizeof( displayWrite );
+
+	return 0;
 }
 
 
 
-// LED State processing loop
-inline uint8_t LED_scan()
+// ----- Capabilities -----
+
+// Selects an animation
+void LED_animation_capability( uint8_t state, uint8_t stateType, uint8_t *args )
 {
+	// Display capability name
+	if ( stateType == 0xFF && state == 0xFF )
+	{
+		print("LED_animation(id)");
+		return;
+	}
 
-	// I2C Busy
-	// S & I2C_S_BUSY
-	//I2C_S_BUSY
+	// Only on press
+	if ( stateType == 0x00 && state == 0x01 )
+		LED_selectAnimation( args[0] );
+}
 
-	return 0;
+// Sets the global brightness
+void LED_brightness_capability( uint8_t state, uint8_t stateType, uint8_t *args )
+{
+	// Display capability name
+	if ( stateType == 0xFF && state == 0xFF )
+	{
+		print("LED_brightness(brightness)");
+		return;
+	}
+
+	// Only on press
+	if ( stateType == 0x00 && state == 0x01 )
+		LED_setBrightness( args[0] );
+}
+
+// Lights up a channel in the reactive animation
+void LED_animationHit_capability( uint8_t state, uint8_t stateType, uint8_t *args )
+{
+	// Display capability name
+	if ( stateType == 0xFF && state == 0xFF )
+	{
+		print("LED_animationHit(channel)");
+		return;
+	}
+
+	// Only on press
+	if ( stateType == 0x00 && state == 0x01 )
+		LED_animationHit( args[0] );
 }
 
 
 
 // ----- CLI Command Functions -----
 
-void cliFunc_i2cSend( char* args )
+void cliFunc_ledAnim( char* args )
 {
 	char* curArgs;
 	char* arg1Ptr;
 	char* arg2Ptr = args;
 
-	// Buffer used after interpretting the args, will be sent to I2C functions
-	// NOTE: Limited to 8 bytes currently (can be increased if necessary
-	#define i2cSend_BuffLenMax 8
-	uint8_t buffer[ i2cSend_BuffLenMax ];
-	uint8_t bufferLen = 0;
-
-	// No \r\n by default after the command is entered
-	print( NL );
-	info_msg("Sending: ");
+	print( NL ); // No \r\n by default after the command is entered
 
-	// Parse args until a \0 is found
-	while ( bufferLen < i2cSend_BuffLenMax )
+	// Animation id, then frame rate
+	CLI_argumentIsolation( args, &arg1Ptr, &arg2Ptr );
+	if ( *arg1Ptr != '\0' )
 	{
-		curArgs = arg2Ptr; // Use the previous 2nd arg pointer to separate the next arg from the list
-		CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+		uint8_t id = numToInt( arg1Ptr );
 
-		// Stop processing args if no more are found
-		if ( *arg1Ptr == '\0' )
-			break;
-
-		// If | is found, end sequence and start new one
-		if ( *arg1Ptr == '|' )
+		curArgs = arg2Ptr;
+		CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+		if ( *arg1Ptr != '\0' )
 		{
-			print("| ");
-			I2C_Send( buffer, bufferLen, 0 );
-			bufferLen = 0;
-			continue;
+			// Clamp to 1 -> 1000 fps
+			int rate = numToInt( arg1Ptr );
+			LED_frameRate = rate < 1 ? 1 : rate > LED_FrameRateMax ? LED_FrameRateMax : rate;
 		}
 
-		// Interpret the argument
-		buffer[ bufferLen++ ] = (uint8_t)numToInt( arg1Ptr );
-
-		// Print out the arg
-		dPrint( arg1Ptr );
-		print(" ");
+		LED_selectAnimation( id );
 	}
 
-	print( NL );
-
-	I2C_Send( buffer, bufferLen, 0 );
+	info_msg("Animation: ");
+	printInt8( LED_animationId );
+	print(" @ ");
+	printInt16( LED_frameRate );
+	print(" fps, ");
+	printInt16( LED_frameBudget );
+	print(" us budget" NL );
+	info_msg("Frames: ");
+	printInt32( LED_framesComputed );
+	print(" (dropped: ");
+	printInt32( LED_framesDropped );
+	print(")" NL );
+	info_msg("Compute: ");
+	printInt32( LED_frameCyclesLast / ( F_CPU / 1000000 ) );
+	print(" us (max: ");
+	printInt32( LED_frameCyclesMax / ( F_CPU / 1000000 ) );
+	print(" us)" NL );
+	info_msg("Sync: ");
+	printInt32( LED_syncsSent );
+	print(" sent, ");
+	printInt32( LED_syncsApplied );
+	print(" applied (offset: ");
+	printInt16( LED_animationOffset );
+	print(")");
 }
 
-void cliFunc_i2cRecv( char* args )
+void cliFunc_ledBright( char* args )
 {
 	char* curArgs;
 	char* arg1Ptr;
 	char* arg2Ptr = args;
 
-	// Buffer used after interpretting the args, will be sent to I2C functions
-	// NOTE: Limited to 8 bytes currently (can be increased if necessary
-	#define i2cSend_BuffLenMax 8
-	uint8_t buffer[ i2cSend_BuffLenMax ];
-	uint8_t bufferLen = 0;
-
-	// No \r\n by default after the command is entered
-	print( NL );
-	info_msg("Sending: ");
-
-	// Parse args until a \0 is found
-	while ( bufferLen < i2cSend_BuffLenMax )
-	{
-		curArgs = arg2Ptr; // Use the previous 2nd arg pointer to separate the next arg from the list
-		CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
-
-		// Stop processing args if no more are found
-		if ( *arg1Ptr == '\0' )
-			break;
-
-		// If | is found, end sequence and start new one
-		if ( *arg1Ptr == '|' )
-		{
-			print("| ");
-			I2C_Send( buffer, bufferLen, 0 );
-			bufferLen = 0;
-			continue;
-		}
-
-		// Interpret the argument
-		buffer[ bufferLen++ ] = (uint8_t)numToInt( arg1Ptr );
-
-		// Print out the arg
-		dPrint( arg1Ptr );
-		print(" ");
-	}
+	print( NL ); // No \r\n by default after the command is entered
 
-	print( NL );
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	if ( *arg1Ptr != '\0' )
+		LED_setBrightness( numToInt( arg1Ptr ) );
 
-	I2C_Send( buffer, bufferLen, 1 ); // Only 1 byte is ever read at a time with the ISSI chip
+	info_msg("Brightness: ");
+	printInt8( LED_brightness );
 }
 
 void cliFunc_ledPage( char* args )
@@ -804,28 +807,59 @@ void cliFunc_ledPage( char* args )
 	// No \r\n by default after the command is entered
 	print( NL );
 
-	LED_readPage( 0xB4, page );
+	if ( !LED_readPage( 0xB4, page ) )
+	{
+		warn_print("I2C busy, try again");
+	}
 }
 
 void cliFunc_ledStart( char* args )
 {
 	print( NL ); // No \r\n by default after the command is entered
-	LED_zeroPages( 0x0B, 1, 0x00, 0x0C ); // Control Registers
-	//LED_zeroPages( 0x00, 8, 0x00, 0xB4 ); // LED Registers
-	LED_writeReg( 0x0A, 0x01, 0x0B );
-	LED_sendPage( (uint8_t*)LED_ledEnableMask, sizeof( LED_ledEnableMask ), 0 );
 
+	// Zeroed Control Registers, this also displays frame page 0 again
+	uint8_t control[ 0x0C + 2 ] = { LED_Address, 0x00 };
+
+	if ( !LED_writePage( control, sizeof( control ), 0x0B )
+		|| !LED_writeReg( 0x0A, 0x01, 0x0B )
+		|| !LED_sendPage( (uint8_t*)LED_ledEnableMask, sizeof( LED_ledEnableMask ), 0 ) )
+	{
+		warn_print("I2C queue full, try again");
+	}
+	LED_displayPage = 0;
+}
+
+void cliFunc_ledStats( char* args )
+{
+	print( NL ); // No \r\n by default after the command is entered
+	info_msg("Frames: ");
+	printInt32( LED_flushFrames );
+	print( NL );
+	info_msg("I2C Bytes: ");
+	printInt32( LED_flushBytes );
+	print(" (full pages: ");
+	printInt32( LED_flushFrames * ( LED_BufferLength + 2 + 9 ) );
+	print(")" NL );
+	info_msg("Displayed Page: ");
+	printInt8( LED_displayPage );
 }
 
 void cliFunc_ledTest( char* args )
 {
 	print( NL ); // No \r\n by default after the command is entered
-	LED_sendPage( (uint8_t*)examplePage, sizeof( examplePage ), 0 );
+
+	// Shown on the next LED_scan
+	memcpy( &LED_pageBuffer, &examplePage[2], sizeof( LED_Buffer ) );
 }
 
 void cliFunc_ledZero( char* args )
 {
 	print( NL ); // No \r\n by default after the command is entered
-	LED_zeroPages( 0x00, 8, 0x24, 0xB4 ); // Only PWMs
+
+	// Only PWMs, both frame pages are rewritten by LED_scan
+	// The shadows no longer match the output anywhere, so every register is sent
+	memset( &LED_pageBuffer, 0, sizeof( LED_pageBuffer ) );
+	memset( LED_pageShadow, 0xFF, sizeof( LED_pageShadow ) );
+	LED_flushForce = 1;
 }
 
@@ -23,8 +23,43 @@
 
 
 
+// ----- Defines -----
+
+// Number of PWM registers in an ISSI frame page (0x24 to 0xB3)
+#define LED_BufferLength 144
+
+
+
+// ----- Structs -----
+
+typedef struct LED_Buffer {
+	uint8_t buffer[LED_BufferLength];
+} LED_Buffer;
+
+
+
+// ----- Variables -----
+
+// Back buffer of LED brightness values, sent to the LEDs by LED_scan
+// Values are perceived brightness, gamma correction and the global brightness are applied when sent
+extern LED_Buffer LED_pageBuffer;
+
+
+
 // ----- Functions -----
 
 void LED_setup();
 uint8_t LED_scan();
 
+void LED_setBrightness( uint8_t brightness );
+void LED_selectAnimation( uint8_t id );
+
+// Split keyboard animation sync, hooked up to UARTConnect by the scan module
+uint8_t LED_animationSyncEncode( uint8_t *params );
+void    LED_animationSyncApply( uint8_t *params, uint8_t numParams, uint8_t id );
+
+// Capabilities
+void LED_brightness_capability( uint8_t state, uint8_t stateType, uint8_t *args );
+void LED_animation_capability( uint8_t state, uint8_t stateType, uint8_t *args );
+void LED_animationHit_capability( uint8_t state, uint8_t stateType, uint8_t *args );
+
@@ -17,10 +17,27 @@ set ( SubModule 1 )
 # Module C files
 #
 set ( Module_SRCS
+	i2c.c
+	led_anim.c
 	led_scan.c
 )
 
 
+###
+# Gamma correction table (led_gamma.h), generated at build time and stored in flash
+#
+set ( LED_Gamma 2.2 CACHE STRING "ISSI LED gamma correction exponent" )
+
+add_custom_command ( OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/led_gamma.h
+	COMMAND ${ModuleFullPath}/ledGamma.py ${CMAKE_CURRENT_BINARY_DIR}/led_gamma.h --gamma ${LED_Gamma}
+	DEPENDS ${ModuleFullPath}/ledGamma.py
+	COMMENT "Generating ISSI LED Gamma Table"
+)
+set_source_files_properties ( ${ModuleFullPath}/led_scan.c PROPERTIES
+	OBJECT_DEPENDS ${CMAKE_CURRENT_BINARY_DIR}/led_gamma.h
+)
+
+
 ###
 # Compiler Family Compatibility
 #
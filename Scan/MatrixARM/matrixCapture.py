@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+'''
+Streams matrix capture records (see matrix_scan.c) and reports switch bounce and chatter
+
+Usage:
+  matrixCapture.py <serial device> [seconds] [--csv <file>] [--window <ms>]
+
+Captures for the given number of seconds (default 10), or until Ctrl+C.
+Raw sense changes within <window> ms (default 5, MinDebounceTime) of each other are grouped into a single
+bounce burst. Debounce decisions that reverse within the window are flagged as chatter.
+The full timeline can be written as csv for plotting.
+'''
+
+# Copyright (C) 2015 by Jacob Alexander
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+# Imports
+import os
+import struct
+import sys
+import time
+
+sys.path.insert( 0, os.path.join( os.path.dirname( os.path.abspath( __file__ ) ), '..', '..', 'Debug', 'cli' ) )
+from control import Control, ID_SCAN_CAPTURE
+
+
+# Must match MatrixCapture in matrix_scan.h
+RECORD = struct.Struct( "<IBBHH" )
+STATES = "OPHRI"
+
+
+# Timeline of a single key
+class KeyTimeline:
+	def __init__( self, key ):
+		self.key = key
+		self.raw = []       # (time us, level)
+		self.decisions = [] # (time us, state)
+
+	# Groups raw edges into bursts, returns a list of (start us, length us, edges)
+	def bursts( self, window ):
+		bursts = []
+		for time_us, level in self.raw:
+			if bursts and time_us - ( bursts[-1][0] + bursts[-1][1] ) <= window:
+				start, length, edges = bursts[-1]
+				bursts[-1] = ( start, time_us - start, edges + 1 )
+			else:
+				bursts.append( ( time_us, 0, 1 ) )
+		return bursts
+
+	# Press/Release decisions that reversed within the window
+	def chatter( self, window ):
+		events = [ ( t, s ) for t, s in self.decisions if s in ( 1, 3 ) ]
+		return [ ( a, b ) for a, b in zip( events, events[1:] ) if a[1] != b[1] and b[0] - a[0] <= window ]
+
+
+# Main
+def main( argv ):
+	args = list( argv[1:] )
+	csv_path = None
+	window_ms = 5.0
+
+	if '--csv' in args:
+		pos = args.index( '--csv' )
+		csv_path = args[ pos + 1 ]
+		del args[ pos:pos + 2 ]
+	if '--window' in args:
+		pos = args.index( '--window' )
+		window_ms = float( args[ pos + 1 ] )
+		del args[ pos:pos + 2 ]
+
+	if len( args ) < 1:
+		print( __doc__ )
+		return 1
+
+	seconds = float( args[1] ) if len( args ) > 1 else 10.0
+	window = window_ms * 1000
+
+	keys = {}
+	records = []
+	dropped = 0
+	last_time = None
+	wraps = 0
+
+	with Control( args[0] ) as ctrl:
+		ctrl.request( ID_SCAN_CAPTURE, b"\x01" )
+		end = time.time() + seconds
+		try:
+			while time.time() < end:
+				data = ctrl.request( ID_SCAN_CAPTURE )
+				dropped, = struct.unpack_from( "<I", data, 0 )
+				for offset in range( 4, len( data ), RECORD.size ):
+					time_us, key, state, active, inactive = RECORD.unpack_from( data, offset )
+
+					# 32 bit us timestamps wrap around every ~71 minutes
+					if last_time is not None and time_us < last_time:
+						wraps += 1
+					last_time = time_us
+					time_us += wraps << 32
+
+					records.append( ( time_us, key, state, active, inactive ) )
+					timeline = keys.setdefault( key, KeyTimeline( key ) )
+					if state & 0x40:
+						timeline.decisions.append( ( time_us, state & 0x0F ) )
+					else:
+						timeline.raw.append( ( time_us, state >> 7 ) )
+
+				# Poll faster while the ring has data
+				if len( data ) == 4:
+					time.sleep( 0.005 )
+		except KeyboardInterrupt:
+			pass
+		ctrl.request( ID_SCAN_CAPTURE, b"\x00" )
+
+	if csv_path:
+		with open( csv_path, 'w' ) as csv:
+			csv.write( "time_us,key,type,raw,state,active,inactive\n" )
+			for time_us, key, state, active, inactive in records:
+				csv.write( "{0},{1},{2},{3},{4},{5},{6}\n".format(
+					time_us, key,
+					"decision" if state & 0x40 else "raw",
+					state >> 7,
+					STATES[ min( state & 0x0F, 4 ) ],
+					active, inactive
+				) )
+
+	print( "{0} records, {1} dropped".format( len( records ), dropped ) )
+	print( "Key   Presses  Bursts  Max Edges  Max Bounce (ms)  Chatter" )
+	worst = 0
+	for key in sorted( keys ):
+		timeline = keys[ key ]
+		bursts = timeline.bursts( window )
+		chatter = timeline.chatter( window )
+		presses = sum( 1 for t, s in timeline.decisions if s == 1 )
+		max_edges = max( ( b[2] for b in bursts ), default=0 )
+		max_bounce = max( ( b[1] for b in bursts ), default=0 ) / 1000
+		worst = max( worst, max_bounce )
+		print( "0x{0:02X}  {1:7}  {2:6}  {3:9}  {4:15.3f}  {5:7}{6}".format(
+			key, presses, len( bursts ), max_edges, max_bounce, len( chatter ),
+			"  <- chatter" if chatter else ""
+		) )
+
+	print( "Longest bounce: {0:.3f} ms (MinDebounceTime should be at least this)".format( worst ) )
+	return 0
+
+if __name__ == '__main__':
+	sys.exit( main( sys.argv ) )
+
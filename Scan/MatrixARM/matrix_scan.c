@@ -26,6 +26,7 @@
 
 // Project Includes
 #include <cli.h>
+#include <control.h>
 #include <kll.h>
 #include <led.h>
 #include <print.h>
@@ -41,6 +42,10 @@
 
 // ----- Defines -----
 
+// Matrix module log level
+#undef  LogModuleLevel
+#define LogModuleLevel MatrixLogLevel_define
+
 #if ( DebounceThrottleDiv_define > 0 )
 nat_ptr_t Matrix_divCounter = 0;
 #endif
@@ -53,6 +58,10 @@ nat_ptr_t Matrix_divCounter = 0;
 void cliFunc_matrixDebug( char* args );
 void cliFunc_matrixState( char* args );
 
+// Control Functions
+uint8_t Matrix_controlScanArray  ( uint8_t* data, uint8_t len );
+uint8_t Matrix_controlScanCapture( uint8_t* data, uint8_t len );
+
 
 
 // ----- Variables -----
@@ -67,6 +76,13 @@ CLIDict_Def( matrixCLIDict, "Matrix Module Commands" ) = {
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
+// Scan Module control requests
+const ControlItem matrixControlDict[] = {
+	{ ControlId_ScanArray,   Matrix_controlScanArray },
+	{ ControlId_ScanCapture, Matrix_controlScanCapture },
+	{ 0, 0 } // Null entry for dictionary end
+};
+
 // Debounce Array
 KeyState Matrix_scanArray[ Matrix_colsNum * Matrix_rowsNum ];
 
@@ -82,6 +98,16 @@ uint16_t matrixMaxScans  = 0;
 uint16_t matrixCurScans  = 0;
 uint16_t matrixPrevScans = 0;
 
+// Matrix Capture - Ring of raw sense changes and debounce decisions, drained by the host (see matrixCapture.py)
+// Filled by Matrix_scan and drained from the CLI, both in the main loop
+uint8_t       matrixCaptureEnabled = 0;
+uint16_t      matrixCaptureHead    = 0;
+uint16_t      matrixCaptureTail    = 0;
+uint32_t      matrixCaptureDropped = 0;
+uint32_t      matrixCaptureTime;
+uint8_t       matrixCaptureRaw[ ( Matrix_colsNum * Matrix_rowsNum + 7 ) / 8 ];
+MatrixCapture matrixCaptureBuffer[ MatrixCaptureSize_define ];
+
 // System Timer used for delaying debounce decisions
 extern volatile uint32_t systick_millis_count;
 
@@ -173,9 +199,7 @@ void Matrix_setup()
 {
 	// Register Matrix CLI dictionary
 	CLI_registerDictionary( matrixCLIDict, matrixCLIDictName );
-
-	info_msg("Columns:  ");
-	printHex( Matrix_colsNum );
+	Control_registerDictionary( matrixControlDict );
 
 	// Setup Strobe Pins
 	for ( uint8_t pin = 0; pin < Matrix_colsNum; pin++ )
@@ -183,19 +207,23 @@ void Matrix_setup()
 		Matrix_pin( Matrix_cols[ pin ], Type_StrobeSetup );
 	}
 
-	print( NL );
-	info_msg("Rows:     ");
-	printHex( Matrix_rowsNum );
-
 	// Setup Sense Pins
 	for ( uint8_t pin = 0; pin < Matrix_rowsNum; pin++ )
 	{
 		Matrix_pin( Matrix_rows[ pin ], Type_SenseSetup );
 	}
 
-	print( NL );
-	info_msg("Max Keys: ");
-	printHex( Matrix_maxKeys );
+	if ( log_enabled( LogLevel_Info ) )
+	{
+		info_msg("Columns:  ");
+		printHex( Matrix_colsNum );
+		print( NL );
+		info_msg("Rows:     ");
+		printHex( Matrix_rowsNum );
+		print( NL );
+		info_msg("Max Keys: ");
+		printHex( Matrix_maxKeys );
+	}
 
 	// Clear out Debounce Array
 	for ( uint8_t item = 0; item < Matrix_maxKeys; item++ )
@@ -241,6 +269,33 @@ void Matrix_keyPositionDebug( KeyPosition pos )
 }
 
 
+// Timestamp in us, same as micros() but leaves interrupts alone (already disabled during the scan)
+inline uint32_t Matrix_captureTimestamp()
+{
+	uint32_t current = SYST_CVR;
+	uint32_t count = systick_millis_count;
+	if ( (SCB_ICSR & SCB_ICSR_PENDSTSET) && current > ((F_CPU / 1000) - 50) ) count++;
+	current = ((F_CPU / 1000) - 1) - current;
+	return count * 1000 + current / (F_CPU / 1000000);
+}
+
+// Adds a record to the capture ring, dropped if the host isn't keeping up
+void Matrix_captureAdd( uint8_t key, uint8_t state, KeyState *keyState )
+{
+	if ( (uint16_t)(matrixCaptureHead - matrixCaptureTail) >= MatrixCaptureSize_define )
+	{
+		matrixCaptureDropped++;
+		return;
+	}
+
+	MatrixCapture *record = &matrixCaptureBuffer[ matrixCaptureHead++ & ( MatrixCaptureSize_define - 1 ) ];
+	record->time          = matrixCaptureTime;
+	record->key           = key;
+	record->state         = state;
+	record->activeCount   = keyState->activeCount   > 0xFFFF ? 0xFFFF : keyState->activeCount;
+	record->inactiveCount = keyState->inactiveCount > 0xFFFF ? 0xFFFF : keyState->inactiveCount;
+}
+
 // Scan the matrix for keypresses
 // NOTE: scanNum should be reset to 0 after a USB send (to reset all the counters)
 void Matrix_scan( uint16_t scanNum )
@@ -269,6 +324,10 @@ void Matrix_scan( uint16_t scanNum )
 	// Read systick for event scheduling
 	uint8_t currentTime = (uint8_t)systick_millis_count;
 
+	// Capture records all share the scan timestamp
+	if ( matrixCaptureEnabled )
+		matrixCaptureTime = Matrix_captureTimestamp();
+
 	// For each strobe, scan each of the sense pins
 	for ( uint8_t strobe = 0; strobe < Matrix_colsNum; strobe++ )
 	{
@@ -297,7 +356,8 @@ void Matrix_scan( uint16_t scanNum )
 			// Somewhat longer with switch bounciness
 			// The advantage of this is that the count is ongoing and never needs to be reset
 			// State still needs to be kept track of to deal with what to send to the Macro module
-			if ( Matrix_pin( Matrix_rows[ sense ], Type_Sense ) )
+			uint8_t sensed = Matrix_pin( Matrix_rows[ sense ], Type_Sense ) ? 1 : 0;
+			if ( sensed )
 			{
 				// Only update if not going to wrap around
 				if ( state->activeCount < DebounceDivThreshold_define ) state->activeCount += 1;
@@ -311,6 +371,14 @@ void Matrix_scan( uint16_t scanNum )
 				state->activeCount >>= 1;
 			}
 
+			// Capture raw sense changes, with the last debounced state
+			if ( matrixCaptureEnabled && sensed != ( ( matrixCaptureRaw[ key >> 3 ] >> ( key & 7 ) ) & 1 ) )
+			{
+				matrixCaptureRaw[ key >> 3 ] ^= 1 << ( key & 7 );
+				KeyPosition position = state->curState == KeyState_Invalid ? state->prevState : state->curState;
+				Matrix_captureAdd( key, sensed << 7 | position, state );
+			}
+
 			// Check for state change if it hasn't been set
 			// But only if enough time has passed since last state change
 			// Only check if the minimum number of scans has been met
@@ -378,8 +446,14 @@ void Matrix_scan( uint16_t scanNum )
 				// Send keystate to macro module
 				Macro_keyState( key, state->curState );
 
+				// Capture debounce decisions that change the key position
+				if ( matrixCaptureEnabled && state->curState != state->prevState )
+				{
+					Matrix_captureAdd( key, sensed << 7 | 0x40 | state->curState, state );
+				}
+
 				// Matrix Debug, only if there is a state change
-				if ( matrixDebugMode && state->curState != state->prevState )
+				if ( log_enabled( LogLevel_Debug ) && matrixDebugMode && state->curState != state->prevState )
 				{
 					// Basic debug output
 					if ( matrixDebugMode == 1 && state->curState == KeyState_Press )
@@ -501,3 +575,51 @@ void cliFunc_matrixState ( char* args )
 	}
 }
 
+
+
+// ----- Control Request Functions -----
+
+uint8_t Matrix_controlScanArray( uint8_t* data, uint8_t len )
+{
+	// One byte per key, previous state in the upper nibble
+	Control_replyBegin( Matrix_maxKeys );
+	for ( uint8_t key = 0; key < Matrix_maxKeys; key++ )
+	{
+		uint8_t state = Matrix_scanArray[ key ].prevState << 4 | Matrix_scanArray[ key ].curState;
+		Control_write( &state, 1 );
+	}
+
+	return ControlStatus_Ok;
+}
+
+uint8_t Matrix_controlScanCapture( uint8_t* data, uint8_t len )
+{
+	// Enable/disable, the ring and raw levels are reset when enabled
+	if ( len >= 1 )
+	{
+		if ( data[0] && !matrixCaptureEnabled )
+		{
+			matrixCaptureHead = 0;
+			matrixCaptureTail = 0;
+			matrixCaptureDropped = 0;
+			for ( uint8_t byte = 0; byte < sizeof( matrixCaptureRaw ); byte++ )
+				matrixCaptureRaw[ byte ] = 0;
+		}
+		matrixCaptureEnabled = data[0] ? 1 : 0;
+	}
+
+	// <dropped u32> <records>, at most half the ring per request to keep the CLI responsive
+	uint16_t count = matrixCaptureHead - matrixCaptureTail;
+	if ( count > MatrixCaptureSize_define / 2 )
+		count = MatrixCaptureSize_define / 2;
+
+	Control_replyBegin( sizeof( matrixCaptureDropped ) + count * sizeof( MatrixCapture ) );
+	Control_write( (uint8_t*)&matrixCaptureDropped, sizeof( matrixCaptureDropped ) );
+	while ( count-- > 0 )
+	{
+		Control_write( (uint8_t*)&matrixCaptureBuffer[ matrixCaptureTail++ & ( MatrixCaptureSize_define - 1 ) ], sizeof( MatrixCapture ) );
+	}
+
+	return ControlStatus_Ok;
+}
+
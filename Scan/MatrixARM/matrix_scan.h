@@ -46,6 +46,10 @@
 #error "MinDebounceTime is a minimum 0 ms"
 #endif
 
+#if ( MatrixCaptureSize_define & ( MatrixCaptureSize_define - 1 ) )
+#error "MatrixCaptureSize must be a power of two"
+#endif
+
 
 
 // ----- Enums -----
@@ -139,6 +143,17 @@ typedef struct KeyState {
 	uint8_t         prevDecisionTime;
 } __attribute__((packed)) KeyState;
 
+// Capture Record
+// state - Bit 7: raw sense level, Bit 6: 1 debounce decision, 0 raw sense change, Bits 3-0: KeyPosition
+// Counts are saturated to 16 bits
+typedef struct MatrixCapture {
+	uint32_t time; // us
+	uint8_t  key;
+	uint8_t  state;
+	uint16_t activeCount;
+	uint16_t inactiveCount;
+} __attribute__((packed)) MatrixCapture;
+
 
 
 // ----- Functions -----
@@ -110,7 +110,9 @@ class STLcdGraphic:
 		return display
 
 
-filename = "ic_logo_lcd.bmp"
+# Manual conversion and preview of a single bitmap
+# The build converts everything in bitmaps/ with lcdAssets.py
+filename = "bitmaps/ic_logo_lcd.bmp"
 max_height = 32
 max_width = 128
 x_offset = 0
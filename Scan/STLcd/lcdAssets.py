@@ -0,0 +1,287 @@
+#!/usr/bin/env python3
+'''
+Converts the LCD bitmaps and fonts into flash arrays in the ST7565 display layout
+'''
+
+# Copyright (C) 2015 by Jacob Alexander
+#
+# This file is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This file is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this file.  If not, see <http://www.gnu.org/licenses/>.
+
+# Imports
+import argparse
+import os
+import re
+import struct
+import sys
+
+
+# Largest asset lcd_fb.c can draw (LCD_Bitmap and LCD_Font sizes are 8 bits)
+max_size = 255
+
+# Longest RLE run or literal
+rle_max_count = 128
+
+
+def error( message ):
+	print( "ERROR: {0}".format( message ) )
+	sys.exit( 1 )
+
+
+# C identifier from a filename
+def asset_name( filename ):
+	name = os.path.splitext( os.path.basename( filename ) )[0]
+	return re.sub( '[^0-9A-Za-z_]', '_', name )
+
+
+# Loads an uncompressed BMP (1, 4, 8, 24 or 32 bits per pixel)
+# Returns rows of pixels, top row first, dark pixels are set (same as bitmap2Struct.py)
+def read_bmp( filename ):
+	with open( filename, 'rb' ) as infile:
+		data = infile.read()
+
+	if data[0:2] != b'BM':
+		error( "'{0}' is not a BMP file".format( filename ) )
+
+	offset = struct.unpack_from( '<I', data, 10 )[0]
+	header_size, width, height, planes, bpp, compression = struct.unpack_from( '<IiiHHI', data, 14 )
+	if compression != 0 or bpp not in ( 1, 4, 8, 24, 32 ):
+		error( "'{0}' must be an uncompressed 1, 4, 8, 24 or 32 bit BMP".format( filename ) )
+
+	# Palette (BGRx), only used up to 8 bits per pixel
+	palette = []
+	if bpp <= 8:
+		colors = struct.unpack_from( '<I', data, 46 )[0] or 1 << bpp
+		for index in range( 0, colors ):
+			pos = 14 + header_size + index * 4
+			palette.append( ( data[pos + 2], data[pos + 1], data[pos] ) )
+
+	# Rows are stored bottom up unless the height is negative, each padded to 4 bytes
+	top_down = height < 0
+	height = abs( height )
+	row_size = ( bpp * width + 31 ) // 32 * 4
+
+	rows = []
+	for y in range( 0, height ):
+		row_pos = offset + ( y if top_down else height - 1 - y ) * row_size
+		row = []
+		for x in range( 0, width ):
+			if bpp <= 8:
+				bit = x * bpp
+				index = ( data[row_pos + bit // 8] >> ( 8 - bpp - bit % 8 ) ) & ( ( 1 << bpp ) - 1 )
+				red, green, blue = palette[index]
+			else:
+				pos = row_pos + x * bpp // 8
+				blue, green, red = data[pos], data[pos + 1], data[pos + 2]
+
+			row.append( red * 299 + green * 587 + blue * 114 < 128000 )
+		rows.append( row )
+
+	return rows
+
+
+# Loads a text font
+# Returns the glyph size, advance and a dictionary of code -> rows of pixels, top row first
+def read_font( filename ):
+	width = height = advance = None
+	glyphs = {}
+	code = None
+
+	with open( filename, 'r' ) as infile:
+		for number, line in enumerate( infile, 1 ):
+			line = line.rstrip( '\r\n' )
+			fields = line.split()
+			location = "{0}:{1}".format( filename, number )
+
+			# Glyph rows come first, they may start with a '#' as well
+			if code is not None and len( glyphs[code] ) < height:
+				if len( line ) != width or line.strip( '#.' ) != '':
+					error( "{0}: expected {1} pixels of '#' or '.'".format( location, width ) )
+				glyphs[code].append( [ pixel == '#' for pixel in line ] )
+			elif not fields or line.startswith( '#' ):
+				continue
+			elif fields[0] == 'size':
+				width, height = int( fields[1] ), int( fields[2] )
+			elif fields[0] == 'advance':
+				advance = int( fields[1] )
+			elif fields[0] == 'glyph':
+				if width is None:
+					error( "{0}: glyph before the font size".format( location ) )
+				code = int( fields[1], 0 )
+				if glyphs and code != max( glyphs ) + 1:
+					error( "{0}: glyphs must be consecutive, expected 0x{1:02X}".format( location, max( glyphs ) + 1 ) )
+				glyphs[code] = []
+			else:
+				error( "{0}: unexpected '{1}'".format( location, line ) )
+
+	if not glyphs:
+		error( "'{0}' has no glyphs".format( filename ) )
+
+	for code, rows in glyphs.items():
+		if len( rows ) != height:
+			error( "'{0}': glyph 0x{1:02X} has {2} rows, not {3}".format( filename, code, len( rows ), height ) )
+
+	return width, height, advance or width + 1, glyphs
+
+
+# Packs pixels into pages of columns, bottom page first, LSB is the bottom row (display layout)
+# If the height isn't a multiple of 8, the top page only uses its low bits
+def pack( rows, width ):
+	height = len( rows )
+	pages = ( height + 7 ) // 8
+	data = [0] * ( pages * width )
+
+	for y, row in enumerate( rows ):
+		row_bit = height - 1 - y
+		for x, pixel in enumerate( row ):
+			if pixel:
+				data[row_bit // 8 * width + x] |= 1 << ( row_bit % 8 )
+
+	return data
+
+
+# Run-length encoding, decoded on the fly by lcd_fb.c
+#  0x00 -> 0x7F - Literal, the next ( control + 1 ) bytes are copied
+#  0x80 -> 0xFF - Run, the next byte is repeated ( ( control & 0x7F ) + 1 ) times
+def rle( data ):
+	output = []
+	literal = []
+
+	def flush():
+		if literal:
+			output.extend( [ len( literal ) - 1 ] + literal )
+			del literal[:]
+
+	pos = 0
+	while pos < len( data ):
+		run = 1
+		while pos + run < len( data ) and data[pos + run] == data[pos] and run < rle_max_count:
+			run += 1
+
+		# Short runs are cheaper as part of a literal
+		if run >= 3:
+			flush()
+			output.extend( [ 0x80 | ( run - 1 ), data[pos] ] )
+			pos += run
+			continue
+
+		literal.append( data[pos] )
+		pos += 1
+		if len( literal ) == rle_max_count:
+			flush()
+
+	flush()
+	return output
+
+
+def c_array( name, data, comments=None, per_line=16 ):
+	output = "const uint8_t {0}[] = {{\n".format( name )
+
+	for line, pos in enumerate( range( 0, len( data ), per_line ) ):
+		output += "\t" + " ".join( "0x{0:02x},".format( byte ) for byte in data[pos : pos + per_line] )
+		if comments:
+			output += " // {0}".format( comments[line] )
+		output += "\n"
+
+	output += "};\n"
+	return output
+
+
+# Main
+parser = argparse.ArgumentParser( description='Converts the LCD bitmaps and fonts into flash arrays' )
+parser.add_argument( 'output', help='Output directory for lcd_assets.h and lcd_assets_data.h' )
+parser.add_argument( '--bitmaps', help='Directory of .bmp files' )
+parser.add_argument( '--fonts', nargs='*', default=[], help='Font files' )
+parser.add_argument( '--rle', action='store_true', help='Run-length encode bitmaps that get smaller' )
+args = parser.parse_args()
+
+declarations = ""
+definitions = ""
+total = 0
+
+# Bitmaps
+bitmaps = []
+if args.bitmaps:
+	bitmaps = sorted(
+		os.path.join( args.bitmaps, filename )
+		for filename in os.listdir( args.bitmaps )
+		if filename.lower().endswith( '.bmp' )
+	)
+
+for filename in bitmaps:
+	name = "LCD_bitmap_{0}".format( asset_name( filename ) )
+	rows = read_bmp( filename )
+	width, height = len( rows[0] ) if rows else 0, len( rows )
+	if width > max_size or height > max_size:
+		error( "'{0}' is {1}x{2}, must be no larger than {3}x{3}".format( filename, width, height, max_size ) )
+
+	data = pack( rows, width )
+	encoding = "LCD_Encoding_Raw"
+	description = "raw"
+	if args.rle:
+		encoded = rle( data )
+		if len( encoded ) < len( data ):
+			description = "RLE, {0} bytes raw".format( len( data ) )
+			encoding = "LCD_Encoding_RLE"
+			data = encoded
+	total += len( data )
+
+	declarations += "// {0} - {1}x{2}, {3} bytes ({4})\n".format(
+		os.path.basename( filename ), width, height, len( data ), description )
+	declarations += "extern const struct LCD_Bitmap {0};\n\n".format( name )
+
+	definitions += c_array( name + "_data", data )
+	definitions += "const LCD_Bitmap {0} = {{ {1}, {2}, {3}, sizeof( {0}_data ), {0}_data }};\n\n".format(
+		name, width, height, encoding )
+
+# Fonts, not encoded as glyphs are looked up directly
+for filename in args.fonts:
+	name = "LCD_font_{0}".format( asset_name( filename ) )
+	width, height, advance, glyphs = read_font( filename )
+	if width > max_size or height > max_size or advance > max_size:
+		error( "'{0}' glyphs must be no larger than {1}x{1}".format( filename, max_size ) )
+
+	first, last = min( glyphs ), max( glyphs )
+	data = []
+	comments = []
+	for code in range( first, last + 1 ):
+		data += pack( glyphs[code], width )
+		comments += [ "'{0}'".format( chr( code ) ) if 0x20 <= code <= 0x7E else "0x{0:02X}".format( code ) ] \
+			* ( ( height + 7 ) // 8 )
+	total += len( data )
+
+	declarations += "// {0} - {1}x{2}, 0x{3:02X} -> 0x{4:02X}, {5} bytes\n".format(
+		os.path.basename( filename ), width, height, first, last, len( data ) )
+	declarations += "#define {0}_Width   {1}\n".format( name, width )
+	declarations += "#define {0}_Height  {1}\n".format( name, height )
+	declarations += "#define {0}_Advance {1}\n".format( name, advance )
+	declarations += "extern const struct LCD_Font {0};\n\n".format( name )
+
+	definitions += c_array( name + "_glyphs", data, comments, width )
+	definitions += "const LCD_Font {0} = {{ {1}, {2}, {3}, 0x{4:02X}, 0x{5:02X}, {0}_glyphs }};\n\n".format(
+		name, width, height, advance, first, last )
+
+header = "// Generated by lcdAssets.py, do not edit\n\n"
+header += "#pragma once\n\n"
+
+with open( os.path.join( args.output, 'lcd_assets.h' ), 'w' ) as outfile:
+	outfile.write( header )
+	outfile.write( declarations )
+	outfile.write( "// Flash used by the assets\n" )
+	outfile.write( "#define LCD_AssetBytes {0}\n\n".format( total ) )
+
+with open( os.path.join( args.output, 'lcd_assets_data.h' ), 'w' ) as outfile:
+	outfile.write( header )
+	outfile.write( "// Stored in flash, only included by lcd_fb.c\n\n" )
+	outfile.write( definitions )
+
@@ -0,0 +1,250 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <string.h> // for memset()
+
+// Local Includes
+#include "lcd_fb.h"
+
+// Generated Includes
+#include "lcd_assets_data.h" // Bitmaps and fonts, generated by lcdAssets.py during the build
+
+
+
+// ----- Structs -----
+
+// Run-length decoder, bytes come out in the raw layout order
+typedef struct LCD_RLEState {
+	const uint8_t *pos;
+	uint8_t        count;  // Bytes left in the current run or literal
+	uint8_t        repeat; // Current control byte is a run
+} LCD_RLEState;
+
+
+
+// ----- Variables -----
+
+uint8_t LCD_frameBuffer[ LCD_TOTAL_VISIBLE_PAGES ][ LCD_PAGE_LEN ];
+
+uint8_t LCD_dirtyStart[ LCD_TOTAL_VISIBLE_PAGES ];
+uint8_t LCD_dirtyEnd[ LCD_TOTAL_VISIBLE_PAGES ];
+
+
+
+// ----- Functions -----
+
+// Sets the masked bits of a framebuffer byte, marking the column dirty if it changed
+static void LCD_fbUpdate( int16_t page, int16_t col, uint8_t mask, uint8_t bits )
+{
+	if ( mask == 0 || page < 0 || page >= LCD_TOTAL_VISIBLE_PAGES )
+		return;
+
+	uint8_t *byte = &LCD_frameBuffer[ page ][ col ];
+	uint8_t value = ( *byte & ~mask ) | ( bits & mask );
+	if ( value == *byte )
+		return;
+	*byte = value;
+
+	if ( LCD_dirtyStart[ page ] >= LCD_dirtyEnd[ page ] )
+	{
+		LCD_dirtyStart[ page ] = col;
+		LCD_dirtyEnd[ page ] = col + 1;
+	}
+	else if ( col < LCD_dirtyStart[ page ] )
+	{
+		LCD_dirtyStart[ page ] = col;
+	}
+	else if ( col >= LCD_dirtyEnd[ page ] )
+	{
+		LCD_dirtyEnd[ page ] = col + 1;
+	}
+}
+
+// Sets the masked bits of an 8 row window of a column
+// row is the display row of the LSB (0 is the bottom), the window may straddle two pages
+static void LCD_fbColumn( int16_t col, int16_t row, uint8_t mask, uint8_t bits )
+{
+	if ( col < 0 || col >= LCD_Width || row <= -8 || row >= LCD_Height )
+		return;
+
+	// Rows may be negative (clipped at the bottom), keep the division positive
+	int16_t  page  = ( row + 8 ) / 8 - 1;
+	uint8_t  shift = ( row + 8 ) & 0x7;
+	uint16_t wideMask = mask << shift;
+	uint16_t wideBits = bits << shift;
+
+	LCD_fbUpdate( page,     col, wideMask,      wideBits );
+	LCD_fbUpdate( page + 1, col, wideMask >> 8, wideBits >> 8 );
+}
+
+// Mask of the low rows of a bitmap page
+static uint8_t LCD_rowMask( uint8_t rows )
+{
+	return rows >= 8 ? 0xFF : ( 1 << rows ) - 1;
+}
+
+void LCD_fbClear()
+{
+	LCD_fbFill( 0, 0, LCD_Width, LCD_Height, 0 );
+}
+
+void LCD_fbMarkAll()
+{
+	memset( LCD_dirtyStart, 0, sizeof( LCD_dirtyStart ) );
+	memset( LCD_dirtyEnd, LCD_PAGE_LEN, sizeof( LCD_dirtyEnd ) );
+}
+
+void LCD_fbMarkSent( uint8_t page, uint8_t end )
+{
+	if ( end >= LCD_dirtyEnd[ page ] )
+	{
+		LCD_dirtyStart[ page ] = LCD_PAGE_LEN;
+		LCD_dirtyEnd[ page ] = 0;
+		return;
+	}
+
+	if ( end > LCD_dirtyStart[ page ] )
+		LCD_dirtyStart[ page ] = end;
+}
+
+void LCD_fbPixel( int16_t x, int16_t y, uint8_t on )
+{
+	LCD_fbColumn( x, LCD_Height - 1 - y, 0x01, on ? 0x01 : 0x00 );
+}
+
+void LCD_fbFill( int16_t x, int16_t y, uint8_t w, uint8_t h, uint8_t on )
+{
+	// Bottom row of the area
+	int16_t row = LCD_Height - ( y + h );
+
+	for ( uint8_t offset = 0; offset < h; offset += 8 )
+	{
+		uint8_t mask = LCD_rowMask( h - offset );
+		for ( uint8_t col = 0; col < w; col++ )
+			LCD_fbColumn( x + col, row + offset, mask, on ? mask : 0x00 );
+	}
+}
+
+// Draws 8 rows of a bitmap column
+static void LCD_fbBlitColumn( int16_t col, int16_t row, uint8_t mask, uint8_t bits, LCD_BlitMode mode )
+{
+	switch ( mode )
+	{
+	case LCD_Blit_Or:
+		LCD_fbColumn( col, row, mask & bits, bits );
+		break;
+
+	case LCD_Blit_Invert:
+		LCD_fbColumn( col, row, mask, ~bits );
+		break;
+
+	case LCD_Blit_Copy:
+	default:
+		LCD_fbColumn( col, row, mask, bits );
+		break;
+	}
+}
+
+// Next decoded byte
+//  0x00 -> 0x7F - Literal of ( control + 1 ) bytes
+//  0x80 -> 0xFF - Run, the next byte ( ( control & 0x7F ) + 1 ) times
+static uint8_t LCD_rleNext( LCD_RLEState *state )
+{
+	if ( state->count == 0 )
+	{
+		uint8_t control = *state->pos++;
+		state->count = ( control & 0x7F ) + 1;
+		state->repeat = control & 0x80;
+	}
+	state->count--;
+
+	// Runs only move past their byte once it has been repeated
+	if ( state->repeat && state->count > 0 )
+		return *state->pos;
+
+	return *state->pos++;
+}
+
+void LCD_fbBlit( int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *bitmap, LCD_BlitMode mode )
+{
+	// Bottom row of the bitmap
+	int16_t row = LCD_Height - ( y + h );
+
+	for ( uint8_t page = 0; page * 8 < h; page++ )
+	{
+		uint8_t mask = LCD_rowMask( h - page * 8 );
+		const uint8_t *src = &bitmap[ page * w ];
+
+		for ( uint8_t col = 0; col < w; col++ )
+			LCD_fbBlitColumn( x + col, row + page * 8, mask, src[ col ], mode );
+	}
+}
+
+void LCD_fbBitmap( int16_t x, int16_t y, const LCD_Bitmap *bitmap, LCD_BlitMode mode )
+{
+	if ( bitmap->encoding != LCD_Encoding_RLE )
+	{
+		LCD_fbBlit( x, y, bitmap->width, bitmap->height, bitmap->data, mode );
+		return;
+	}
+
+	// Decoded in the same order as LCD_fbBlit reads the raw layout, nothing is buffered
+	LCD_RLEState state = { bitmap->data, 0, 0 };
+	int16_t row = LCD_Height - ( y + bitmap->height );
+
+	for ( uint8_t page = 0; page * 8 < bitmap->height; page++ )
+	{
+		uint8_t mask = LCD_rowMask( bitmap->height - page * 8 );
+
+		for ( uint8_t col = 0; col < bitmap->width; col++ )
+			LCD_fbBlitColumn( x + col, row + page * 8, mask, LCD_rleNext( &state ), mode );
+	}
+}
+
+int16_t LCD_fbText( int16_t x, int16_t y, const char *text, LCD_BlitMode mode )
+{
+	return LCD_fbFontText( x, y, &LCD_font_text, text, mode );
+}
+
+int16_t LCD_fbFontText( int16_t x, int16_t y, const LCD_Font *font, const char *text, LCD_BlitMode mode )
+{
+	uint16_t glyphLen = font->width * ( ( font->height + 7 ) / 8 );
+
+	for ( ; *text != '\0' && x < LCD_Width; text++ )
+	{
+		uint8_t ch = *text;
+		if ( ch < font->first || ch > font->last )
+			ch = '?';
+
+		// Characters the font doesn't have (not even '?') are left blank
+		if ( ch >= font->first && ch <= font->last )
+			LCD_fbBlit( x, y, font->width, font->height, &font->glyphs[ ( ch - font->first ) * glyphLen ], mode );
+		else if ( mode != LCD_Blit_Or )
+			LCD_fbFill( x, y, font->width, font->height, mode == LCD_Blit_Invert );
+
+		// Gap between glyphs
+		if ( mode != LCD_Blit_Or )
+			LCD_fbFill( x + font->width, y, font->advance - font->width, font->height, mode == LCD_Blit_Invert );
+
+		x += font->advance;
+	}
+
+	return x;
+}
+
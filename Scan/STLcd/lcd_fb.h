@@ -0,0 +1,113 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdint.h>
+
+// Generated Includes
+#include "lcd_assets.h" // Generated by lcdAssets.py during the build
+
+
+
+// ----- Defines -----
+
+// LCD framebuffer
+// 1 bit per pixel, laid out like the display RAM, so pages are sent as is
+// Each page is 8 rows high, one byte per column, the display shows page 0 at the bottom and the LSB
+// of each byte is the bottom row of its page. Drawing coordinates start at the top left (0, 0).
+//
+// Bitmaps are in the same layout (as generated by lcdAssets.py), pages bottom up, so blitting
+// is only a shift, never a transposition. If the height isn't a multiple of 8, the top page only
+// uses its low bits.
+#define LCD_TOTAL_VISIBLE_PAGES 4
+#define LCD_PAGE_LEN 128
+
+#define LCD_Width  LCD_PAGE_LEN
+#define LCD_Height ( LCD_TOTAL_VISIBLE_PAGES * 8 )
+
+// Text font (fonts/text.font), 5x7 glyphs (8 rows including the space below) for ASCII 0x20 -> 0x7E
+#define LCD_FontWidth   LCD_font_text_Width
+#define LCD_FontHeight  LCD_font_text_Height
+#define LCD_FontAdvance LCD_font_text_Advance
+
+
+
+// ----- Enums -----
+
+typedef enum LCD_BlitMode {
+	LCD_Blit_Copy,   // Bitmap replaces the area it covers
+	LCD_Blit_Or,     // Only set pixels are drawn
+	LCD_Blit_Invert, // Copy with every pixel inverted (highlighted text)
+} LCD_BlitMode;
+
+typedef enum LCD_Encoding {
+	LCD_Encoding_Raw, // Pages of columns, as drawn
+	LCD_Encoding_RLE, // Run-length encoded pages of columns, decoded while drawing (see lcdAssets.py)
+} LCD_Encoding;
+
+
+
+// ----- Structs -----
+
+// Bitmap asset, generated from bitmaps/*.bmp
+typedef struct LCD_Bitmap {
+	uint8_t        width;
+	uint8_t        height;
+	uint8_t        encoding; // LCD_Encoding
+	uint16_t       length;   // Bytes of data
+	const uint8_t *data;
+} LCD_Bitmap;
+
+// Font asset, generated from fonts/*.font
+// Glyphs are raw so they can be indexed, ( height + 7 ) / 8 pages of width columns each
+typedef struct LCD_Font {
+	uint8_t        width;
+	uint8_t        height;
+	uint8_t        advance; // Columns from one glyph to the next
+	uint8_t        first;   // Lowest and highest character codes
+	uint8_t        last;
+	const uint8_t *glyphs;
+} LCD_Font;
+
+
+
+// ----- Variables -----
+
+extern uint8_t LCD_frameBuffer[ LCD_TOTAL_VISIBLE_PAGES ][ LCD_PAGE_LEN ];
+
+// Changed columns of each page not yet sent to the display, start >= end when there are none
+extern uint8_t LCD_dirtyStart[ LCD_TOTAL_VISIBLE_PAGES ];
+extern uint8_t LCD_dirtyEnd[ LCD_TOTAL_VISIBLE_PAGES ];
+
+
+
+// ----- Functions -----
+
+void    LCD_fbClear();
+void    LCD_fbMarkAll(); // Every column needs to be sent again (e.g. the display was reset)
+void    LCD_fbMarkSent( uint8_t page, uint8_t end ); // Columns of the page up to end were sent
+
+void    LCD_fbPixel( int16_t x, int16_t y, uint8_t on );
+void    LCD_fbFill( int16_t x, int16_t y, uint8_t w, uint8_t h, uint8_t on );
+void    LCD_fbBlit( int16_t x, int16_t y, uint8_t w, uint8_t h, const uint8_t *bitmap, LCD_BlitMode mode );
+void    LCD_fbBitmap( int16_t x, int16_t y, const LCD_Bitmap *bitmap, LCD_BlitMode mode );
+int16_t LCD_fbText( int16_t x, int16_t y, const char *text, LCD_BlitMode mode ); // Returns x after the text
+int16_t LCD_fbFontText( int16_t x, int16_t y, const LCD_Font *font, const char *text, LCD_BlitMode mode );
+
@@ -18,6 +18,7 @@
 
 // Compiler Includes
 #include <Lib/ScanLib.h>
+#include <string.h> // for memset()
 
 // Project Includes
 #include <cli.h>
@@ -25,21 +26,17 @@
 #include <print.h>
 
 // Local Includes
+#include "lcd_fb.h"
 #include "lcd_scan.h"
+#include "lcd_status.h"
+#include "spi.h"
 
 
 
 // ----- Defines -----
 
-#define LCD_TOTAL_VISIBLE_PAGES 4
-#define LCD_PAGE_LEN 128
-
-
-
-// ----- Macros -----
-
-// Number of entries in the SPI0 TxFIFO
-#define SPI0_TxFIFO_CNT ( ( SPI0_SR & SPI_SR_TXCTR ) >> 12 )
+// Control bytes sent before each span of changed columns (page, column address)
+#define LCD_SpanSetup 3
 
 
 
@@ -50,7 +47,10 @@
 // CLI Functions
 void cliFunc_lcdCmd( char* args );
 void cliFunc_lcdInit( char* args );
+void cliFunc_lcdStats( char* args );
+void cliFunc_lcdStatus( char* args );
 void cliFunc_lcdTest( char* args );
+void cliFunc_lcdText( char* args );
 
 
 
@@ -65,15 +65,28 @@ uint8_t cliNormalReverseToggleState = 0;
 // Scan Module command dictionary
 CLIDict_Entry( lcdCmd,      "Send byte via SPI, second argument enables a0. Defaults to control." );
 CLIDict_Entry( lcdInit,     "Re-initialize the LCD display." );
+CLIDict_Entry( lcdStats,    "Show LCD render statistics." );
+CLIDict_Entry( lcdStatus,   "Clear the LCD display and draw the layer and host LED status again." );
 CLIDict_Entry( lcdTest,     "Test out the LCD display." );
+CLIDict_Entry( lcdText,     "Draw text on the LCD display. First two args are x and y, the rest is the text." );
 
 CLIDict_Def( lcdCLIDict, "ST LCD Module Commands" ) = {
 	CLIDict_Item( lcdCmd ),
 	CLIDict_Item( lcdInit ),
+	CLIDict_Item( lcdStats ),
+	CLIDict_Item( lcdStatus ),
 	CLIDict_Item( lcdTest ),
+	CLIDict_Item( lcdText ),
 	{ 0, 0, 0 } // Null entry for dictionary end
 };
 
+// Renderer, the framebuffer pages are visited in turn so a busy page can't hold up the others
+uint8_t  LCD_renderPage = 0;
+
+// Render statistics
+uint32_t LCD_renderSpans = 0;
+uint32_t LCD_renderBytes = 0;
+
 
 
 // ----- Interrupt Functions -----
@@ -82,72 +95,21 @@ CLIDict_Def( lcdCLIDict, "ST LCD Module Commands" ) = {
 
 // ----- Functions -----
 
-inline void SPI_setup()
-{
-	// Enable SPI internal clock
-	SIM_SCGC6 |= SIM_SCGC6_SPI0;
-
-	// Setup MOSI (SOUT) and SCLK (SCK)
-	PORTC_PCR6 = PORT_PCR_DSE | PORT_PCR_MUX(2);
-	PORTC_PCR5 = PORT_PCR_DSE | PORT_PCR_MUX(2);
-
-	// Setup SS (PCS)
-	PORTC_PCR4 = PORT_PCR_DSE | PORT_PCR_MUX(2);
-
-	// Master Mode, CS0
-	SPI0_MCR = SPI_MCR_MSTR | SPI_MCR_PCSIS(1);
-
-	// DSPI Clock and Transfer Attributes
-	// Frame Size: 8 bits
-	// MSB First
-	// CLK Low by default
-	SPI0_CTAR0 = SPI_CTAR_FMSZ(7)
-		| SPI_CTAR_ASC(7)
-		| SPI_CTAR_DT(7)
-		| SPI_CTAR_CSSCK(7)
-		| SPI_CTAR_PBR(0) | SPI_CTAR_BR(7);
-}
-
-// Write buffer to SPI FIFO
-void SPI_write( uint8_t *buffer, uint8_t len )
+// Queues bytes for the display, waiting for room in the SPI queue if needed
+// Only for use outside of LCD_scan (setup and CLI), LCD_render never waits
+void LCD_send( uint8_t a0, uint8_t *buffer, uint16_t len )
 {
+	if ( !SPI_available( 1, len ) )
+		SPI_sync();
 
-	for ( uint8_t byte = 0; byte < len; byte++ )
-	{
-		// Wait for SPI TxFIFO to have 4 or fewer entries
-		while ( !( SPI0_SR & SPI_SR_TFFF ) )
-			delayMicroseconds(10);
-
-		// Write byte to TxFIFO
-		// CS0, CTAR0
-		SPI0_PUSHR = ( buffer[ byte ] & 0xff ) | SPI_PUSHR_PCS(1);
-
-		// Indicate transfer has completed
-		while ( !( SPI0_SR & SPI_SR_TCF ) );
-		SPI0_SR |= SPI_SR_TCF;
-	}
+	SPI_submit( a0, buffer, len );
 }
 
 // Write to a control register
 void LCD_writeControlReg( uint8_t byte )
 {
-	// Wait for TxFIFO to be empt
-	while ( SPI0_TxFIFO_CNT != 0 );
-
-	// Set A0 low to enter control register mode
-	GPIOC_PCOR |= (1<<7);
-
-	// Write byte to SPI FIFO
-	SPI_write( &byte, 1 );
-
-	// Wait for TxFIFO to be empty
-	while ( SPI0_TxFIFO_CNT != 0 );
-
-	// Make sure data has transferred
-	delayMicroseconds(10); // XXX Adjust if SPI speed changes
-
-	// Set A0 high to go back to display register mode
-	GPIOC_PSOR |= (1<<7);
+	// A0 low to enter control register mode, the SPI queue sets it back for display data
+	LCD_send( 0, &byte, 1 );
 }
 
 // Write to display register
@@ -166,7 +128,7 @@ void LCD_writeDisplayReg( uint8_t page, uint8_t *buffer, uint8_t len )
 	LCD_writeControlReg( 0x00 );
 
 	// Write buffer to SPI
-	SPI_write( buffer, len );
+	LCD_send( 1, buffer, len );
 }
 
 inline void LCD_clearPage( uint8_t page )
@@ -181,16 +143,10 @@ inline void LCD_clearPage( uint8_t page )
 	LCD_writeControlReg( 0x10 );
 	LCD_writeControlReg( 0x00 );
 
-	for ( uint8_t page_reg = 0; page_reg < LCD_PAGE_LEN; page_reg++ )
-	{
-		uint8_t byte = 0;
-
-		// Write buffer to SPI
-		SPI_write( &byte, 1 );
-	}
-
-	// Wait for TxFIFO to be empty
-	while ( SPI0_TxFIFO_CNT != 0 );
+	// Write buffer to SPI
+	uint8_t zeros[ LCD_PAGE_LEN ];
+	memset( zeros, 0, sizeof( zeros ) );
+	LCD_send( 1, zeros, sizeof( zeros ) );
 }
 
 // Clear Display
@@ -274,14 +230,55 @@ inline void LCD_setup()
 
 	// Run LCD intialization sequence
 	LCD_initialize();
+	SPI_sync();
+
+	// Layer and host LED status
+	LCD_statusSetup();
+}
+
+
+// Queues the changed columns of each page from the framebuffer, as many spans as the SPI queue has room for
+// The bytes are copied into the queue, so drawing may carry on while they're sent
+void LCD_render()
+{
+	for ( uint8_t count = 0; count < LCD_TOTAL_VISIBLE_PAGES; count++ )
+	{
+		uint8_t page = LCD_renderPage;
+
+		uint8_t start = LCD_dirtyStart[ page ];
+		uint8_t end = LCD_dirtyEnd[ page ];
+		if ( start < end )
+		{
+			if ( !SPI_available( 2, LCD_SpanSetup + end - start ) )
+				return;
+
+			// Set the register page and column address, the column increments as data is written
+			uint8_t setup[ LCD_SpanSetup ] = {
+				0xB0 | ( 0x0F & page ),
+				0x10 | ( start >> 4 ),
+				0x00 | ( start & 0x0F ),
+			};
+			SPI_submit( 0, setup, sizeof( setup ) );
+			SPI_submit( 1, &LCD_frameBuffer[ page ][ start ], end - start );
+			LCD_fbMarkSent( page, end );
+
+			LCD_renderSpans++;
+			LCD_renderBytes += end - start;
+		}
+
+		LCD_renderPage = ( LCD_renderPage + 1 ) % LCD_TOTAL_VISIBLE_PAGES;
+	}
 }
 
 
 // LCD State processing loop
+// Drawing only touches the framebuffer, the changes are queued here and sent by the SPI ISR
 inline uint8_t LCD_scan()
 {
-	// NOP - Screen Refresh
-	//LCD_writeControlReg( 0xE3 );
+	// Draw any layer or host LED changes before sending
+	LCD_statusScan();
+
+	LCD_render();
 	return 0;
 }
 
@@ -293,6 +290,33 @@ void cliFunc_lcdInit( char* args )
 {
 	print( NL ); // No \r\n by default after the command is entered
 	LCD_initialize();
+
+	// Display RAM was cleared, send the whole framebuffer again
+	LCD_fbMarkAll();
+}
+
+void cliFunc_lcdStats( char* args )
+{
+	print( NL ); // No \r\n by default after the command is entered
+
+	info_msg("Spans: ");
+	printInt32( LCD_renderSpans );
+	print( NL );
+	info_msg("Bytes: ");
+	printInt32( LCD_renderBytes );
+	print( NL );
+	info_msg("Dirty: ");
+	for ( uint8_t page = 0; page < LCD_TOTAL_VISIBLE_PAGES; page++ )
+	{
+		print(" ");
+		printInt8( LCD_dirtyStart[ page ] < LCD_dirtyEnd[ page ] ? LCD_dirtyEnd[ page ] - LCD_dirtyStart[ page ] : 0 );
+	}
+}
+
+void cliFunc_lcdStatus( char* args )
+{
+	print( NL ); // No \r\n by default after the command is entered
+	LCD_statusRedraw();
 }
 
 void cliFunc_lcdTest( char* args )
@@ -303,21 +327,48 @@ void cliFunc_lcdTest( char* args )
 	// Test pattern
 	uint8_t pattern[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
 
-
-uint8_t logo[] = {
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x03, 0x03, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc0, 0xc0, 0xc0, 0xc0, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x03, 0x03, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-};
 	//uint8_t pattern[] = { 0xFF, 0x00, 0x96, 0xFF, 0x00, 0xFF, 0x00 };
 
 	// Write to page D0
 	//LCD_writeDisplayReg( 0, pattern, sizeof( pattern ) );
 
-	for ( uint8_t page = 0; page < LCD_TOTAL_VISIBLE_PAGES; page++ )
+	// Sent by LCD_scan
+	const LCD_Bitmap *logo = &LCD_bitmap_ic_logo_lcd;
+	LCD_fbClear();
+	LCD_fbBitmap( ( LCD_Width - logo->width ) / 2, ( LCD_Height - logo->height ) / 2, logo, LCD_Blit_Copy );
+}
+
+void cliFunc_lcdText( char* args )
+{
+	char* curArgs;
+	char* arg1Ptr;
+	char* arg2Ptr = args;
+
+	print( NL ); // No \r\n by default after the command is entered
+
+	// Position
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	if ( *arg1Ptr == '\0' )
+		return;
+	int16_t x = numToInt( arg1Ptr );
+
+	curArgs = arg2Ptr;
+	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+	if ( *arg1Ptr == '\0' )
+		return;
+	int16_t y = numToInt( arg1Ptr );
+
+	// Each word, separated by a space
+	while ( 1 )
 	{
-		LCD_writeDisplayReg( page, &logo[page * LCD_PAGE_LEN], LCD_PAGE_LEN );
+		curArgs = arg2Ptr;
+		CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
+		if ( *arg1Ptr == '\0' )
+			break;
+
+		x = LCD_fbText( x, y, arg1Ptr, LCD_Blit_Copy );
+		x = LCD_fbText( x, y, " ", LCD_Blit_Copy );
 	}
 }
 
@@ -338,6 +389,7 @@ void cliFunc_lcdCmd( char* args )
 
 	// SPI Command
 	uint8_t cmd = (uint8_t)numToInt( arg1Ptr );
+	uint8_t a0 = 0;
 
 	curArgs = arg2Ptr; // Use the previous 2nd arg pointer to separate the next arg from the list
 	CLI_argumentIsolation( curArgs, &arg1Ptr, &arg2Ptr );
@@ -346,11 +398,15 @@ void cliFunc_lcdCmd( char* args )
 	if ( *arg1Ptr == '\0' )
 		goto cmd;
 
-	// TODO Deal with a0
+	// A0 level, 0 - control register, 1 - display data
+	a0 = numToInt( arg1Ptr ) ? 1 : 0;
+
 cmd:
 	info_msg("Sending - ");
 	printHex( cmd );
+	print(" A0 ");
+	printInt8( a0 );
 	print( NL );
-	LCD_writeControlReg( cmd );
+	LCD_send( a0, &cmd, 1 );
 }
 
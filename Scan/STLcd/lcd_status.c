@@ -0,0 +1,182 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/ScanLib.h>
+
+// Project Includes
+#include <macro.h>
+#include <output_com.h>
+#include <print.h>
+
+// Local Includes
+#include "lcd_fb.h"
+#include "lcd_status.h"
+
+
+
+// ----- Defines -----
+
+// Status display layout (128x32)
+//  Top left  - Top layer of the stack, large digits (fonts/digits.font)
+//  Top right - Name of the top layer, then the layer stack (e.g. 0:1:3)
+//  Bottom    - Host LEDs (Num Lock, Caps Lock, Scroll Lock), highlighted when on
+#define LCD_StatusDigitCount 2
+
+#define LCD_StatusTextX  ( LCD_StatusDigitCount * LCD_font_digits_Advance + 2 )
+#define LCD_StatusNameY  0
+#define LCD_StatusStackY 8
+#define LCD_StatusLEDY   24
+
+// Longest layer stack string drawn (the rest wouldn't fit anyway)
+#define LCD_StatusStackLength ( LCD_Width / LCD_FontAdvance + 1 )
+
+
+
+// ----- Enums -----
+
+// Pending changes, only the affected parts of the display are drawn again
+typedef enum LCD_StatusEvent {
+	LCD_StatusEvent_Layer = 0x01, // Layer stack changed (Macro_layerNotify)
+	LCD_StatusEvent_LEDs  = 0x02, // Host LEDs changed (USBKeys_LEDs)
+	LCD_StatusEvent_All   = 0xFF, // Everything, e.g. after the framebuffer was cleared
+} LCD_StatusEvent;
+
+
+
+// ----- Variables -----
+
+// Host LED labels and positions, USB HID LED bits 0 -> 2
+const char   *LCD_statusLEDNames[] = { " NUM ", " CAPS ", " SCRL " };
+const uint8_t LCD_statusLEDX[] = { 0, 32, 70 };
+#define LCD_StatusLEDCount ( sizeof( LCD_statusLEDX ) / sizeof( LCD_statusLEDX[0] ) )
+
+// Changes not yet drawn, many changes between two scans are drawn once
+volatile uint8_t LCD_statusEvents = 0;
+
+// What's currently drawn
+uint16_t LCD_statusLayer = 0;
+uint8_t  LCD_statusLEDs = 0;
+
+
+
+// ----- Functions -----
+
+// Layer stack subscriber, called from Macro_layerState
+void LCD_statusLayerChanged()
+{
+	LCD_statusEvents |= LCD_StatusEvent_Layer;
+}
+
+void LCD_statusSetup()
+{
+	Macro_layerNotify = LCD_statusLayerChanged;
+	LCD_statusEvents = LCD_StatusEvent_All;
+}
+
+void LCD_statusRedraw()
+{
+	LCD_fbClear();
+	LCD_statusEvents = LCD_StatusEvent_All;
+}
+
+// Draws a line of text, clearing the rest of the line
+void LCD_statusLine( int16_t x, int16_t y, const char *text )
+{
+	x = LCD_fbText( x, y, text, LCD_Blit_Copy );
+	if ( x < LCD_Width )
+		LCD_fbFill( x, y, LCD_Width - x, LCD_FontHeight, 0 );
+}
+
+// Top layer number, name and the layer stack
+void LCD_statusDrawLayers()
+{
+	uint16_t top = macroLayerIndexStackSize > 0 ? macroLayerIndexStack[ macroLayerIndexStackSize - 1 ] : 0;
+
+	// Number and name only change with the top layer
+	if ( top != LCD_statusLayer || LCD_statusEvents == LCD_StatusEvent_All )
+	{
+		LCD_statusLayer = top;
+
+		// Right aligned, unused leading digits are blank (the digits font has no space)
+		char number[ LCD_StatusDigitCount + 1 ];
+		uint16_t value = top;
+		for ( int8_t digit = LCD_StatusDigitCount - 1; digit >= 0; digit-- )
+		{
+			number[ digit ] = value > 0 || digit == LCD_StatusDigitCount - 1 ? '0' + value % 10 : ' ';
+			value /= 10;
+		}
+		number[ LCD_StatusDigitCount ] = '\0';
+		LCD_fbFontText( 0, 0, &LCD_font_digits, number, LCD_Blit_Copy );
+
+		LCD_statusLine( LCD_StatusTextX, LCD_StatusNameY, Macro_layerName( top ) );
+	}
+
+	// Layer stack, bottom first (the default layer is always there)
+	char stack[ LCD_StatusStackLength + 1 ] = "0";
+	uint8_t len = 1;
+	for ( uint16_t item = 0; item < macroLayerIndexStackSize && len + 6 < LCD_StatusStackLength; item++ )
+	{
+		stack[ len++ ] = ':';
+		int16ToStr( macroLayerIndexStack[ item ], &stack[ len ] );
+		while ( stack[ len ] != '\0' )
+			len++;
+	}
+	stack[ len ] = '\0';
+
+	// Only the columns that changed are sent to the display
+	LCD_statusLine( LCD_StatusTextX, LCD_StatusStackY, stack );
+}
+
+// Host LED labels, only the ones that changed
+void LCD_statusDrawLEDs( uint8_t leds )
+{
+	uint8_t changed = LCD_statusEvents == LCD_StatusEvent_All ? 0xFF : leds ^ LCD_statusLEDs;
+	LCD_statusLEDs = leds;
+
+	for ( uint8_t led = 0; led < LCD_StatusLEDCount; led++ )
+	{
+		if ( !( changed & (1 << led) ) )
+			continue;
+
+		LCD_fbText( LCD_statusLEDX[ led ], LCD_StatusLEDY, LCD_statusLEDNames[ led ],
+			leds & (1 << led) ? LCD_Blit_Invert : LCD_Blit_Copy );
+	}
+}
+
+// Called from LCD_scan, nothing is drawn unless there was a change
+// Drawing only updates the framebuffer, LCD_render sends the changed columns
+void LCD_statusScan()
+{
+	// Host LEDs are set by the USB stack, a byte compare is all it takes to notice a change
+	uint8_t leds = USBKeys_LEDs;
+	if ( leds != LCD_statusLEDs )
+		LCD_statusEvents |= LCD_StatusEvent_LEDs;
+
+	if ( LCD_statusEvents == 0 )
+		return;
+
+	if ( LCD_statusEvents & LCD_StatusEvent_Layer )
+		LCD_statusDrawLayers();
+
+	if ( LCD_statusEvents & LCD_StatusEvent_LEDs )
+		LCD_statusDrawLEDs( leds );
+
+	LCD_statusEvents = 0;
+}
+
@@ -18,7 +18,37 @@ set ( SubModule 1 )
 #
 
 set( Module_SRCS
+	lcd_fb.c
 	lcd_scan.c
+	lcd_status.c
+	spi.c
+)
+
+
+###
+# LCD assets (lcd_assets.h, lcd_assets_data.h), generated at build time and stored in flash
+# Every .bmp in bitmaps/ becomes an LCD_bitmap_<name>, each font an LCD_font_<name>
+# Re-run cmake after adding a bitmap, so it's picked up as a dependency
+#
+set( LCD_AssetRLE ON CACHE BOOL "Run-length encode LCD bitmaps that get smaller" )
+
+file( GLOB LCD_Bitmaps ${ModuleFullPath}/bitmaps/*.bmp )
+set( LCD_Fonts
+	${ModuleFullPath}/fonts/text.font
+	${ModuleFullPath}/fonts/digits.font
+)
+
+if ( LCD_AssetRLE )
+	set( LCD_AssetFlags --rle )
+endif ()
+
+add_custom_command( OUTPUT ${CMAKE_CURRENT_BINARY_DIR}/lcd_assets.h ${CMAKE_CURRENT_BINARY_DIR}/lcd_assets_data.h
+	COMMAND ${ModuleFullPath}/lcdAssets.py ${CMAKE_CURRENT_BINARY_DIR} --bitmaps ${ModuleFullPath}/bitmaps --fonts ${LCD_Fonts} ${LCD_AssetFlags}
+	DEPENDS ${ModuleFullPath}/lcdAssets.py ${LCD_Bitmaps} ${LCD_Fonts}
+	COMMENT "Generating LCD Assets"
+)
+set_source_files_properties( ${ModuleFullPath}/lcd_fb.c ${ModuleFullPath}/lcd_scan.c ${ModuleFullPath}/lcd_status.c PROPERTIES
+	OBJECT_DEPENDS "${CMAKE_CURRENT_BINARY_DIR}/lcd_assets.h;${CMAKE_CURRENT_BINARY_DIR}/lcd_assets_data.h"
 )
 
 
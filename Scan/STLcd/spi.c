@@ -0,0 +1,323 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <Lib/ScanLib.h>
+
+// Project Includes
+#include <cli.h>
+#include <print.h>
+
+// Local Includes
+#include "spi.h"
+
+
+
+// ----- Defines -----
+
+// Entries in the SPI0 Tx FIFO
+#define SPI_TxFIFOSize 4
+
+
+
+// ----- Macros -----
+
+// Number of entries in the SPI0 TxFIFO
+#define SPI0_TxFIFO_CNT ( ( SPI0_SR & SPI_SR_TXCTR ) >> 12 )
+
+
+
+// ----- Structs -----
+
+// Queued segment
+typedef struct SPI_Segment {
+	uint16_t dataPos; // Start of the bytes in SPI_data
+	uint16_t len;
+	uint8_t  a0;
+} SPI_Segment;
+
+
+
+// ----- Function Declarations -----
+
+// CLI Functions
+void cliFunc_spiStats( char* args );
+
+void SPI_service();
+
+
+
+// ----- Variables -----
+
+// SPI Module command dictionary
+CLIDict_Entry( spiStats,    "Show SPI transmit queue statistics." );
+
+CLIDict_Def( spiCLIDict, "SPI Module Commands" ) = {
+	CLIDict_Item( spiStats ),
+	{ 0, 0, 0 } // Null entry for dictionary end
+};
+
+// Segment queue
+//  SPI_queueTail - Next free entry, advanced by SPI_submit
+//  SPI_queueHead - Segment being sent, advanced by spi0_isr once its last byte is out
+SPI_Segment      SPI_queue[ SPI_QueueLength ];
+volatile uint8_t SPI_queueTail = 0;
+volatile uint8_t SPI_queueHead = 0;
+
+// Segment bytes, freed by spi0_isr along with the segment
+uint8_t           SPI_data[ SPI_DataLength ];
+uint16_t          SPI_dataTail = 0;
+volatile uint16_t SPI_dataUsed = 0;
+
+// Bytes of the head segment pushed into the Tx FIFO
+volatile uint16_t SPI_segmentPos = 0;
+volatile uint8_t  SPI_busy = 0;
+
+// Statistics
+volatile uint32_t SPI_interrupts = 0;
+uint32_t          SPI_segments = 0;
+uint32_t          SPI_bytes = 0;
+uint32_t          SPI_queueFull = 0;
+
+
+
+// ----- Interrupt Functions -----
+
+void spi0_isr()
+{
+	cli(); // Disable Interrupts
+
+	SPI_interrupts++;
+	SPI_service();
+
+	sei(); // Re-enable Interrupts
+}
+
+
+
+// ----- Functions -----
+
+inline uint32_t SPI_irqSave()
+{
+	uint32_t primask;
+	__asm__ volatile ( "mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory" );
+	return primask;
+}
+
+inline void SPI_irqRestore( uint32_t primask )
+{
+	__asm__ volatile ( "msr primask, %0" :: "r" (primask) : "memory" );
+}
+
+inline void SPI_setup()
+{
+	// Register SPI CLI dictionary
+	CLI_registerDictionary( spiCLIDict, spiCLIDictName );
+
+	// Enable SPI internal clock
+	SIM_SCGC6 |= SIM_SCGC6_SPI0;
+
+	// Setup MOSI (SOUT) and SCLK (SCK)
+	PORTC_PCR6 = PORT_PCR_DSE | PORT_PCR_MUX(2);
+	PORTC_PCR5 = PORT_PCR_DSE | PORT_PCR_MUX(2);
+
+	// Setup SS (PCS)
+	PORTC_PCR4 = PORT_PCR_DSE | PORT_PCR_MUX(2);
+
+	// Master Mode, CS0
+	// Nothing is read back from the display, the Rx FIFO is disabled so it can't overflow
+	SPI0_MCR = SPI_MCR_MSTR | SPI_MCR_PCSIS(1) | SPI_MCR_DIS_RXF;
+
+	// DSPI Clock and Transfer Attributes
+	// Frame Size: 8 bits
+	// MSB First
+	// CLK Low by default
+	// SCK is F_BUS / 32 (was F_BUS / 256), the ST7565 is good for up to 20 MHz
+	// PCS to SCK, after SCK and after transfer delays of 8 bus cycles (were 256 each)
+	SPI0_CTAR0 = SPI_CTAR_FMSZ(7)
+		| SPI_CTAR_ASC(2)
+		| SPI_CTAR_DT(2)
+		| SPI_CTAR_CSSCK(2)
+		| SPI_CTAR_PBR(0) | SPI_CTAR_BR(4);
+
+	// Interrupts are enabled per segment
+	SPI0_RSER = 0;
+	SPI0_SR = SPI_SR_EOQF | SPI_SR_TFFF | SPI_SR_TCF;
+	NVIC_ENABLE_IRQ( IRQ_SPI0 );
+}
+
+// Pushes bytes of the head segment into the Tx FIFO until it's full
+// PCS0 stays active between the bytes of a segment, the last byte ends the queue
+void SPI_fill()
+{
+	SPI_Segment *segment = &SPI_queue[ SPI_queueHead & ( SPI_QueueLength - 1 ) ];
+
+	while ( SPI_segmentPos < segment->len && SPI0_TxFIFO_CNT < SPI_TxFIFOSize )
+	{
+		uint8_t byte = SPI_data[ ( segment->dataPos + SPI_segmentPos ) & ( SPI_DataLength - 1 ) ];
+		uint32_t command = ++SPI_segmentPos < segment->len ? SPI_PUSHR_CONT : SPI_PUSHR_EOQ;
+
+		// CS0, CTAR0
+		SPI0_PUSHR = byte | command | SPI_PUSHR_PCS(1);
+	}
+	SPI0_SR = SPI_SR_TFFF;
+
+	// Whole segment is in the FIFO, only wait for the end of queue
+	SPI0_RSER = SPI_segmentPos < segment->len
+		? SPI_RSER_EOQF_RE | SPI_RSER_TFFF_RE
+		: SPI_RSER_EOQF_RE;
+}
+
+// Sets A0 and starts sending the head segment
+// The DSPI is stopped (end of queue of the last segment) or idle, so A0 can't change mid byte
+void SPI_start()
+{
+	SPI_Segment *segment = &SPI_queue[ SPI_queueHead & ( SPI_QueueLength - 1 ) ];
+
+	if ( segment->a0 )
+		GPIOC_PSOR |= (1 << SPI_A0Pin);
+	else
+		GPIOC_PCOR |= (1 << SPI_A0Pin);
+
+	SPI_busy = 1;
+	SPI_segmentPos = 0;
+	SPI_fill();
+
+	// Clearing the end of queue flag starts the DSPI again
+	SPI0_SR = SPI_SR_EOQF;
+}
+
+// Advances the queue on the end of queue flag, otherwise refills the Tx FIFO
+// Called from spi0_isr, or by SPI_sync with interrupts disabled
+void SPI_service()
+{
+	if ( !SPI_busy )
+		return;
+
+	// Last byte of the head segment is out
+	if ( SPI0_SR & SPI_SR_EOQF )
+	{
+		SPI_dataUsed -= SPI_queue[ SPI_queueHead & ( SPI_QueueLength - 1 ) ].len;
+		SPI_queueHead++;
+
+		if ( SPI_queueHead != SPI_queueTail )
+		{
+			SPI_start();
+		}
+		else
+		{
+			SPI_busy = 0;
+			SPI0_RSER = 0;
+			SPI0_SR = SPI_SR_EOQF;
+		}
+		return;
+	}
+
+	SPI_fill();
+}
+
+// Returns 1 if the given number of segments and bytes can be submitted
+uint8_t SPI_available( uint8_t segments, uint16_t bytes )
+{
+	return (uint8_t)( SPI_queueTail - SPI_queueHead ) + segments <= SPI_QueueLength
+		&& SPI_dataUsed + bytes <= SPI_DataLength;
+}
+
+uint8_t SPI_pending()
+{
+	return SPI_queueTail != SPI_queueHead;
+}
+
+// Queues a segment, returns immediately
+uint8_t SPI_submit( uint8_t a0, uint8_t *data, uint16_t len )
+{
+	if ( len == 0 )
+		return 1;
+
+	if ( !SPI_available( 1, len ) )
+	{
+		SPI_queueFull++;
+		return 0;
+	}
+
+	// Copy bytes, the space is only freed by the ISR so no masking is needed yet
+	uint16_t dataPos = SPI_dataTail;
+	for ( uint16_t c = 0; c < len; c++ )
+	{
+		SPI_data[ SPI_dataTail ] = data[ c ];
+		SPI_dataTail = ( SPI_dataTail + 1 ) & ( SPI_DataLength - 1 );
+	}
+
+	SPI_Segment *segment = &SPI_queue[ SPI_queueTail & ( SPI_QueueLength - 1 ) ];
+	segment->dataPos = dataPos;
+	segment->len     = len;
+	segment->a0      = a0;
+
+	// Interrupts may already be disabled (scan loop), so the mask is restored rather than enabled
+	uint32_t primask = SPI_irqSave();
+
+	SPI_dataUsed += len;
+	SPI_queueTail++;
+	SPI_segments++;
+	SPI_bytes += len;
+
+	// Idle, start right away
+	if ( !SPI_busy )
+		SPI_start();
+
+	SPI_irqRestore( primask );
+
+	return 1;
+}
+
+// Services the queue by hand, so it also works from the scan loop (interrupts disabled)
+void SPI_sync()
+{
+	while ( SPI_pending() )
+	{
+		uint32_t primask = SPI_irqSave();
+		SPI_service();
+		SPI_irqRestore( primask );
+	}
+}
+
+
+
+// ----- CLI Command Functions -----
+
+void cliFunc_spiStats( char* args )
+{
+	print( NL ); // No \r\n by default after the command is entered
+	info_msg("Segments: ");
+	printInt32( SPI_segments );
+	print( NL );
+	info_msg("Bytes: ");
+	printInt32( SPI_bytes );
+	print( NL );
+	info_msg("Queue Full: ");
+	printInt32( SPI_queueFull );
+	print( NL );
+	info_msg("Pending: ");
+	printInt8( (uint8_t)( SPI_queueTail - SPI_queueHead ) );
+	print(" (");
+	printInt16( SPI_dataUsed );
+	print(" bytes)" NL );
+	info_msg("Interrupts: ");
+	printInt32( SPI_interrupts );
+}
+
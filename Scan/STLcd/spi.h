@@ -0,0 +1,56 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdint.h>
+
+
+
+// ----- Defines -----
+
+// SPI0 transmit queue
+// Each segment is a run of bytes sent with PCS0 held active, and the level of the display's A0
+// (register select) line while they're sent, 0 - control register, 1 - display data.
+// The last byte of a segment carries the end of queue flag, the DSPI stops once it's out and spi0_isr
+// switches A0 for the next segment. The Tx FIFO is kept full by the ISR, nothing waits on the bus.
+#define SPI_QueueLength 16  // Segments, must be a power of two
+#define SPI_DataLength  512 // Bytes, must be a power of two
+
+#if ( SPI_QueueLength & ( SPI_QueueLength - 1 ) ) != 0
+#error "SPI_QueueLength must be a power of two"
+#endif
+
+#if ( SPI_DataLength & ( SPI_DataLength - 1 ) ) != 0
+#error "SPI_DataLength must be a power of two"
+#endif
+
+// A0 line of the display, PTC7
+#define SPI_A0Pin 7
+
+
+
+// ----- Functions -----
+
+void    SPI_setup();
+uint8_t SPI_submit( uint8_t a0, uint8_t *data, uint16_t len ); // Returns 0 if there isn't enough room in the queue
+uint8_t SPI_available( uint8_t segments, uint16_t bytes );
+uint8_t SPI_pending(); // Segments not yet completely sent
+void    SPI_sync();    // Waits until everything has been sent, also works with interrupts disabled
+
@@ -0,0 +1,416 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ----- Includes -----
+
+// Local Includes
+#include "connect_frame.h"
+
+
+
+// ----- Functions -----
+
+// CRC-16/CCITT (polynomial 0x1021), one byte at a time
+// A nibble at a time lookup, frames are encoded with interrupts disabled so this needs to be quick
+uint16_t ConnectFrame_crc16( uint16_t crc, uint8_t byte )
+{
+	static const uint16_t table[16] = {
+		0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+		0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+	};
+	crc = ( crc << 4 ) ^ table[ ( crc >> 12 ) ^ ( byte >> 4 ) ];
+	crc = ( crc << 4 ) ^ table[ ( crc >> 12 ) ^ ( byte & 0x0F ) ];
+	return crc;
+}
+
+
+// Sends an ACK/NAK/RST/BSY
+// Dropped if there's no room in the Tx buffer, the retransmit timer recovers from that
+void ConnectFrame_control( ConnectLink *link, uint8_t type, uint8_t seq )
+{
+	uint8_t frame[] = { ConnectFrame_SYN, type, seq, (uint8_t)~seq };
+	Connect_linkWrite( link->num, frame, sizeof( frame ) );
+}
+
+// Writes the queued frames to the Tx buffer, as many as fit
+// The retransmit timer runs from the last write, frames waiting for room in the Tx buffer can't time out
+void ConnectFrame_pump( ConnectLink *link, uint32_t now )
+{
+	while ( link->txNext != link->txSeq )
+	{
+		ConnectFrameSlot *slot = &link->txSlot[ link->txNext % ConnectFrame_Window ];
+		if ( !Connect_linkWrite( link->num, slot->data, slot->len ) )
+			break;
+		link->txNext++;
+		link->txTime = now;
+	}
+}
+
+// Resends all of the unacknowledged frames
+void ConnectFrame_resend( ConnectLink *link, uint32_t now )
+{
+	link->retransmits += (uint8_t)( link->txNext - link->txAcked );
+	link->txNext = link->txAcked;
+	link->txTime = now;
+	ConnectFrame_pump( link, now );
+}
+
+// Tells the receiver which sequence number comes next, then resends anything still unacknowledged
+void ConnectFrame_resync( ConnectLink *link, uint32_t now )
+{
+	ConnectFrame_control( link, ConnectFrame_RST, link->txAcked );
+	ConnectFrame_resend( link, now );
+}
+
+
+// Resets both directions of the link, num is passed back to Connect_linkWrite/Connect_linkDeliver
+void ConnectFrame_reset( ConnectLink *link, uint8_t num )
+{
+	link->num = num;
+
+	link->txSeq = 0;
+	link->txAcked = 0;
+	link->txNext = 0;
+	link->txTimeouts = 0;
+	link->txTime = 0;
+
+	link->rxState = ConnectFrameRx_Wait;
+	link->rxExpected = 0;
+	link->rxNakSent = 0;
+
+	link->framesSent = 0;
+	link->framesReceived = 0;
+	link->crcErrors = 0;
+	link->naksSent = 0;
+	link->naksReceived = 0;
+	link->retransmits = 0;
+	link->timeouts = 0;
+	link->duplicates = 0;
+	link->dropped = 0;
+	link->refused = 0;
+	link->busy = 0;
+	link->windowFull = 0;
+	link->resyncs = 0;
+}
+
+
+// Number of frames waiting for an ACK
+uint8_t ConnectFrame_pending( ConnectLink *link )
+{
+	return (uint8_t)( link->txSeq - link->txAcked );
+}
+
+
+// Returns where to write the payload of the next frame, directly into the retransmit window
+// Returns 0 if the window is full (try again later)
+// Nothing else may use the link until ConnectFrame_commit
+uint8_t *ConnectFrame_reserve( ConnectLink *link )
+{
+	if ( ConnectFrame_pending( link ) >= ConnectFrame_Window )
+	{
+		link->windowFull++;
+		return 0;
+	}
+
+	return &link->txSlot[ link->txSeq % ConnectFrame_Window ].data[4];
+}
+
+// Sends the frame whose payload was written to the ConnectFrame_reserve buffer
+void ConnectFrame_commit( ConnectLink *link, uint8_t len, uint32_t now )
+{
+	ConnectFrameSlot *slot = &link->txSlot[ link->txSeq % ConnectFrame_Window ];
+	uint8_t *data = slot->data;
+	uint16_t crc = 0xFFFF;
+
+	data[0] = ConnectFrame_SYN;
+	data[1] = ConnectFrame_SOH;
+	data[2] = link->txSeq;
+	data[3] = len;
+	for ( uint8_t *pos = &data[2]; pos < &data[ len + 4 ]; pos++ )
+	{
+		crc = ConnectFrame_crc16( crc, *pos );
+	}
+	data[ len + 4 ] = (uint8_t)crc;
+	data[ len + 5 ] = (uint8_t)( crc >> 8 );
+	slot->len = len + ConnectFrame_Overhead;
+
+	// Start the retransmit timer if this is the only frame in flight
+	if ( ConnectFrame_pending( link ) == 0 )
+	{
+		link->txTime = now;
+		link->txTimeouts = 0;
+	}
+	link->txSeq++;
+	link->framesSent++;
+
+	// If the Tx buffer is full the frame waits for ConnectFrame_process
+	ConnectFrame_pump( link, now );
+}
+
+// Queues a copy of payload as the next frame
+// Returns 0 if the payload is too large, or the window is full (try again later)
+uint8_t ConnectFrame_send( ConnectLink *link, const uint8_t *payload, uint8_t len, uint32_t now )
+{
+	uint8_t *data = len <= ConnectFrame_MaxPayload ? ConnectFrame_reserve( link ) : 0;
+	if ( !data )
+		return 0;
+
+	for ( uint8_t c = 0; c < len; c++ )
+	{
+		data[ c ] = payload[ c ];
+	}
+	ConnectFrame_commit( link, len, now );
+	return 1;
+}
+
+
+// Writes frames that didn't fit into the Tx buffer yet, and runs the retransmit timer, call periodically
+void ConnectFrame_process( ConnectLink *link, uint32_t now )
+{
+	ConnectFrame_pump( link, now );
+
+	if ( ConnectFrame_pending( link ) == 0 || now - link->txTime < UARTConnectRetransmit_define )
+		return;
+
+	link->timeouts++;
+
+	// Give up on the frames, the other side is probably not there
+	if ( ++link->txTimeouts > UARTConnectRetries_define )
+	{
+		link->dropped += ConnectFrame_pending( link );
+		link->txAcked = link->txSeq;
+		link->txNext = link->txSeq;
+		link->txTimeouts = 0;
+		ConnectFrame_resync( link, now );
+		return;
+	}
+
+	ConnectFrame_resend( link, now );
+}
+
+
+// Handles a verified data frame
+void ConnectFrame_receiveData( ConnectLink *link )
+{
+	uint8_t offset = link->rxSeq - link->rxExpected;
+
+	// In order, pass the payload up then acknowledge
+	// A refused payload (no room for it yet) isn't acknowledged, the BSY tells the sender to send it again later
+	// The frames after it are ignored meanwhile, the BSY stands in for their NAK
+	if ( offset == 0 )
+	{
+		if ( !Connect_linkDeliver( link->num, link->rxPayload, link->rxLen ) )
+		{
+			link->refused++;
+			link->rxNakSent = 1;
+			ConnectFrame_control( link, ConnectFrame_BSY, link->rxSeq );
+			return;
+		}
+
+		link->rxExpected++;
+		link->rxNakSent = 0;
+		link->framesReceived++;
+		ConnectFrame_control( link, ConnectFrame_ACK, link->rxSeq );
+	}
+	// Already received (the ACK was lost), acknowledge again
+	else if ( offset >= (uint8_t)-ConnectFrame_Window )
+	{
+		link->duplicates++;
+		ConnectFrame_control( link, ConnectFrame_ACK, link->rxExpected - 1 );
+	}
+	// A frame was lost, ask for the rest again (only once, the retransmit timer covers a lost NAK)
+	else if ( !link->rxNakSent )
+	{
+		link->rxNakSent = 1;
+		link->naksSent++;
+		ConnectFrame_control( link, ConnectFrame_NAK, link->rxExpected );
+	}
+}
+
+// Handles an ACK/NAK/RST/BSY
+void ConnectFrame_receiveControl( ConnectLink *link, uint32_t now )
+{
+	uint8_t seq = link->rxSeq;
+	uint8_t pending = ConnectFrame_pending( link );
+
+	switch ( link->rxCtrl )
+	{
+	case ConnectFrame_ACK:
+		// Acknowledges seq and everything before it
+		if ( (uint8_t)( seq - link->txAcked ) < pending )
+		{
+			link->txAcked = seq + 1;
+			link->txTime = now;
+			link->txTimeouts = 0;
+
+			// Received even though it was still waiting to be written (an earlier copy got through)
+			if ( (uint8_t)( link->txNext - link->txAcked ) > ConnectFrame_pending( link ) )
+				link->txNext = link->txAcked;
+		}
+		// Anything but a repeated ACK means the receiver has lost track
+		else if ( (uint8_t)( link->txAcked - 1 - seq ) >= ConnectFrame_Window )
+		{
+			ConnectFrame_resync( link, now );
+		}
+		break;
+
+	case ConnectFrame_NAK:
+		link->naksReceived++;
+
+		// Everything before seq was received, resend the rest
+		if ( (uint8_t)( seq - link->txAcked ) <= pending )
+		{
+			link->txAcked = seq;
+			link->txTimeouts = 0;
+			ConnectFrame_resend( link, now );
+		}
+		else
+		{
+			ConnectFrame_resync( link, now );
+		}
+		break;
+
+	case ConnectFrame_BSY:
+		link->busy++;
+
+		// Everything before seq was received, the rest is sent again when the retransmit timer runs out
+		// Not a timeout, the receiver is there, it just can't take seq yet
+		if ( (uint8_t)( seq - link->txAcked ) < pending )
+		{
+			link->txAcked = seq;
+			link->txTime = now;
+			link->txTimeouts = 0;
+		}
+		break;
+
+	case ConnectFrame_RST:
+		// Already have the frames up to seq (a stale RST, sent before the ACKs arrived), never go backwards
+		if ( (uint8_t)( link->rxExpected - seq ) <= ConnectFrame_Window )
+			break;
+
+		link->resyncs++;
+		link->rxExpected = seq;
+		link->rxNakSent = 0;
+		break;
+	}
+}
+
+// Rx frame parser, call for each byte received
+void ConnectFrame_receive( ConnectLink *link, uint8_t byte, uint32_t now )
+{
+	switch ( link->rxState )
+	{
+	case ConnectFrameRx_Wait:
+		if ( byte == ConnectFrame_SYN )
+			link->rxState = ConnectFrameRx_SYN;
+		break;
+
+	case ConnectFrameRx_SYN:
+		switch ( byte )
+		{
+		case ConnectFrame_SYN: // Idle
+			break;
+
+		case ConnectFrame_SOH:
+			link->rxState = ConnectFrameRx_Seq;
+			link->rxCRC = 0xFFFF;
+			break;
+
+		case ConnectFrame_ACK:
+		case ConnectFrame_NAK:
+		case ConnectFrame_RST:
+		case ConnectFrame_BSY:
+			link->rxState = ConnectFrameRx_CtrlSeq;
+			link->rxCtrl = byte;
+			break;
+
+		default:
+			link->crcErrors++;
+			link->rxState = ConnectFrameRx_Wait;
+			break;
+		}
+		break;
+
+	case ConnectFrameRx_Seq:
+		link->rxSeq = byte;
+		link->rxCRC = ConnectFrame_crc16( link->rxCRC, byte );
+		link->rxState = ConnectFrameRx_Len;
+		break;
+
+	case ConnectFrameRx_Len:
+		// Can't be a valid frame, resynchronize on the next SYN
+		if ( byte > ConnectFrame_MaxPayload )
+		{
+			link->crcErrors++;
+			link->rxState = ConnectFrameRx_Wait;
+			break;
+		}
+		link->rxLen = byte;
+		link->rxPos = 0;
+		link->rxCRC = ConnectFrame_crc16( link->rxCRC, byte );
+		link->rxState = byte > 0 ? ConnectFrameRx_Payload : ConnectFrameRx_CRCLow;
+		break;
+
+	case ConnectFrameRx_Payload:
+		link->rxPayload[ link->rxPos++ ] = byte;
+		link->rxCRC = ConnectFrame_crc16( link->rxCRC, byte );
+		if ( link->rxPos >= link->rxLen )
+			link->rxState = ConnectFrameRx_CRCLow;
+		break;
+
+	case ConnectFrameRx_CRCLow:
+		link->rxCRC ^= byte;
+		link->rxState = ConnectFrameRx_CRCHigh;
+		break;
+
+	case ConnectFrameRx_CRCHigh:
+		link->rxCRC ^= (uint16_t)byte << 8;
+		link->rxState = ConnectFrameRx_Wait;
+
+		if ( link->rxCRC == 0 )
+		{
+			ConnectFrame_receiveData( link );
+		}
+		// Corrupted, ask for a resend
+		else
+		{
+			link->crcErrors++;
+			if ( !link->rxNakSent )
+			{
+				link->rxNakSent = 1;
+				link->naksSent++;
+				ConnectFrame_control( link, ConnectFrame_NAK, link->rxExpected );
+			}
+		}
+		break;
+
+	case ConnectFrameRx_CtrlSeq:
+		link->rxSeq = byte;
+		link->rxState = ConnectFrameRx_CtrlCheck;
+		break;
+
+	case ConnectFrameRx_CtrlCheck:
+		link->rxState = ConnectFrameRx_Wait;
+		if ( byte != (uint8_t)~link->rxSeq )
+		{
+			link->crcErrors++;
+			break;
+		}
+		ConnectFrame_receiveControl( link, now );
+		break;
+	}
+}
+
@@ -0,0 +1,146 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdint.h>
+
+// KLL Generated Defines
+#include <kll_defs.h>
+
+
+
+// ----- Defines -----
+
+// UARTConnect link layer
+// Every command is sent as a frame, with a sequence number and CRC
+//
+//  Data: SYN SOH <seq> <len> <payload[len]> <crc16 lo> <crc16 hi>   CRC-16/CCITT over seq, len and payload
+//  ACK:  SYN ACK <seq> <~seq>                                       Frames up to and including seq were received
+//  NAK:  SYN NAK <seq> <~seq>                                       Resend starting from seq
+//  RST:  SYN CAN <seq> <~seq>                                       Next frame sent will be seq (resynchronize)
+//  BSY:  SYN DC3 <seq> <~seq>                                       Frame seq was refused (no room yet), send it again later
+//
+// Up to UARTConnectWindow frames may be waiting for an ACK (go-back-N)
+// A NAK, or no ACK within UARTConnectRetransmit ms, resends all of the unacknowledged frames
+// After UARTConnectRetries timeouts in a row the frames are dropped and the receiver is resynchronized
+// A BSY restarts the count, a busy receiver is still there, so refused frames are never given up on
+// An ACK/NAK that doesn't match the window (e.g. the other side was reset) also resynchronizes the receiver
+// Extra SYNs between frames are ignored (idle)
+#define ConnectFrame_SYN 0x16
+#define ConnectFrame_SOH 0x01
+#define ConnectFrame_ACK 0x06
+#define ConnectFrame_NAK 0x15
+#define ConnectFrame_RST 0x18
+#define ConnectFrame_BSY 0x13
+
+#define ConnectFrame_Overhead   6
+#define ConnectFrame_MaxPayload ( UARTConnectBufSize_define - ConnectFrame_Overhead < 0xFF ? UARTConnectBufSize_define - ConnectFrame_Overhead : 0xFF )
+#define ConnectFrame_Window     UARTConnectWindow_define
+
+#if ( ConnectFrame_Window & ( ConnectFrame_Window - 1 ) ) != 0 || ConnectFrame_Window > 128
+#error "UARTConnectWindow must be a power of two, and no larger than 128"
+#endif
+
+
+
+// ----- Enums -----
+
+// Rx frame parser state
+typedef enum ConnectFrameRx {
+	ConnectFrameRx_Wait,     // Waiting for SYN
+	ConnectFrameRx_SYN,      // SYN received, waiting for SOH/ACK/NAK
+	ConnectFrameRx_Seq,      // Data frame sequence number
+	ConnectFrameRx_Len,      // Data frame payload length
+	ConnectFrameRx_Payload,  // Data frame payload
+	ConnectFrameRx_CRCLow,   // CRC, low byte
+	ConnectFrameRx_CRCHigh,  // CRC, high byte
+	ConnectFrameRx_CtrlSeq,  // ACK/NAK/RST/BSY sequence number
+	ConnectFrameRx_CtrlCheck // ACK/NAK/RST/BSY inverted sequence number
+} ConnectFrameRx;
+
+
+
+// ----- Structs -----
+
+// Encoded frame, kept until acknowledged
+typedef struct ConnectFrameSlot {
+	uint16_t len;
+	uint8_t  data[ ConnectFrame_MaxPayload + ConnectFrame_Overhead ];
+} ConnectFrameSlot;
+
+// State of one direction of a link (one UART)
+typedef struct ConnectLink {
+	uint8_t num; // UART number, passed to Connect_linkWrite/Connect_linkDeliver
+
+	// Tx
+	uint8_t  txSeq;      // Next sequence number to send
+	uint8_t  txAcked;    // Oldest unacknowledged sequence number
+	uint8_t  txNext;     // Next sequence number to write to the Tx buffer
+	uint8_t  txTimeouts; // Timeouts in a row
+	uint32_t txTime;     // When the unacknowledged frames were last sent (ms)
+	ConnectFrameSlot txSlot[ ConnectFrame_Window ];
+
+	// Rx
+	ConnectFrameRx rxState;
+	uint8_t  rxExpected; // Next sequence number to deliver
+	uint8_t  rxNakSent;  // NAK already sent for rxExpected
+	uint8_t  rxSeq;
+	uint8_t  rxLen;
+	uint8_t  rxPos;
+	uint8_t  rxCtrl;     // ACK/NAK/RST/BSY being received
+	uint16_t rxCRC;
+	uint8_t  rxPayload[ ConnectFrame_MaxPayload ];
+
+	// Counters
+	uint32_t framesSent;
+	uint32_t framesReceived;
+	uint32_t crcErrors;  // Includes framing errors
+	uint32_t naksSent;
+	uint32_t naksReceived;
+	uint32_t retransmits;
+	uint32_t timeouts;
+	uint32_t duplicates;
+	uint32_t dropped;    // Frames given up on after UARTConnectRetries timeouts
+	uint32_t refused;    // Frames refused by Connect_linkDeliver, answered with a BSY so they are sent again
+	uint32_t busy;       // BSYs received
+	uint32_t windowFull; // Frames refused by ConnectFrame_send
+	uint32_t resyncs;    // RSTs received
+} ConnectLink;
+
+
+
+// ----- Functions -----
+
+// Provided by the user of the link layer
+uint8_t Connect_linkWrite( uint8_t num, const uint8_t *data, uint16_t len ); // Raw bytes to the UART, all or nothing (returns 0)
+uint8_t Connect_linkDeliver( uint8_t num, uint8_t *payload, uint8_t len ); // Verified, in order, payload (valid until it returns), 0 to refuse
+
+// Link layer
+// Not reentrant, calls for the same link must not interrupt each other
+uint16_t ConnectFrame_crc16( uint16_t crc, uint8_t byte );
+
+void    ConnectFrame_reset( ConnectLink *link, uint8_t num );
+uint8_t ConnectFrame_send( ConnectLink *link, const uint8_t *payload, uint8_t len, uint32_t now );
+uint8_t *ConnectFrame_reserve( ConnectLink *link );
+void    ConnectFrame_commit( ConnectLink *link, uint8_t len, uint32_t now );
+void    ConnectFrame_receive( ConnectLink *link, uint8_t byte, uint32_t now );
+void    ConnectFrame_process( ConnectLink *link, uint32_t now );
+uint8_t ConnectFrame_pending( ConnectLink *link );
+
@@ -18,143 +18,151 @@
 
 // Compiler Includes
 #include <Lib/ScanLib.h>
+#include <Lib/ringbuf.h>
+#include <string.h> // for memcpy(), memmove()
 
 // Project Includes
 #include <cli.h>
 #include <led.h>
 #include <print.h>
 #include <macro.h>
+#include <trace.h>
 
 // Local Includes
+#include "connect_frame.h"
 #include "connect_scan.h"
 
 
 
+// ----- Defines -----
+
+// Connect module log level
+#undef  LogModuleLevel
+#define LogModuleLevel ConnectLogLevel_define
+
+
+
 // ----- Macros -----
 
-// Macro for adding to each uart Tx ring buffer
-#define uart_addTxBuffer( uartNum ) \
+// Link events are recorded in the Connect trace group (traceEnable 2)
+// Most of them happen in the Rx ISRs, where printing would make the ISR time unbounded
+// The format strings aren't in flash, the records are decoded on the host by Debug/trace/traceDecode.py
+#define connect_trace0( fmt )          traceGroup0( TraceGroup_Connect, fmt )
+#define connect_trace1( fmt, a )       traceGroup1( TraceGroup_Connect, fmt, a )
+#define connect_trace2( fmt, a, b )    traceGroup2( TraceGroup_Connect, fmt, a, b )
+#define connect_trace3( fmt, a, b, c ) traceGroup3( TraceGroup_Connect, fmt, a, b, c )
+
+// Macro for writing to each uart Tx ring buffer, all or nothing
+// Done with interrupts disabled as the main loop and the Rx ISRs (ACKs, propagation) both write
+#define uart_writeTx( uartNum ) \
 case uartNum: \
-	while ( uart##uartNum##_buffer_items + count > uart_buffer_size ) \
-	{ \
-		warn_msg("Too much data to send on UART0, waiting..."); \
-		delay( 1 ); \
-	} \
-	for ( uint8_t c = 0; c < count; c++ ) \
+{ \
+	uint32_t primask = Connect_irqSave(); \
+	if ( RingBuf_space( &uart##uartNum##_tx ) < len ) \
 	{ \
-		printHex( buffer[ c ] ); \
-		print( " +" #uartNum NL ); \
-		uart##uartNum##_buffer[ uart##uartNum##_buffer_tail++ ] = buffer[ c ]; \
-		uart##uartNum##_buffer_items++; \
-		if ( uart##uartNum##_buffer_tail >= uart_buffer_size ) \
-			uart##uartNum##_buffer_tail = 0; \
-		if ( uart##uartNum##_buffer_head == uart##uartNum##_buffer_tail ) \
-			uart##uartNum##_buffer_head++; \
-		if ( uart##uartNum##_buffer_head >= uart_buffer_size ) \
-			uart##uartNum##_buffer_head = 0; \
+		connect_trace2("Connect uart%u Tx full, %u bytes refused", uartNum, len ); \
+		Connect_irqRestore( primask ); \
+		return 0; \
 	} \
-	break
+	connect_trace2("Connect uart%u Tx write %u bytes", uartNum, len ); \
+	if ( RingBuf_items( &uart##uartNum##_tx ) == 0 ) \
+		uart##uartNum##_tx_queued = ARM_DWT_CYCCNT; \
+	RingBuf_write( &uart##uartNum##_tx, data, len ); \
+	uart_startTxDMA( uartNum ); \
+	Connect_irqRestore( primask ); \
+	return 1; \
+}
 
-// Macro for popping from Tx ring buffer
-#define uart_fillTxFifo( uartNum ) \
+// Macro for starting the next Tx DMA transfer
+// Sends the contiguous data at the ring buffer head (the rest after wrapping is sent by the next transfer)
+// DMA channel number is the same as the uart number
+// Must be called with interrupts disabled, or from the DMA ISR
+#define uart_startTxDMA( uartNum ) \
 { \
-	uint8_t fifoSize = ( ( UART##uartNum##_PFIFO & UART_PFIFO_TXFIFOSIZE ) >> 2 ); \
-	if ( fifoSize == 0 ) \
-		fifoSize = 1; \
-	while ( UART##uartNum##_TCFIFO < fifoSize ) \
+	if ( uart##uartNum##_dma_count == 0 ) \
 	{ \
-		if ( uart##uartNum##_buffer_items == 0 ) \
-			break; \
-		UART##uartNum##_D = uart##uartNum##_buffer[ uart##uartNum##_buffer_head++ ]; \
-		uart##uartNum##_buffer_items--; \
-		if ( uart##uartNum##_buffer_head >= uart_buffer_size ) \
-			uart##uartNum##_buffer_head = 0; \
+		uint8_t *dmaData; \
+		uint16_t dmaCount = RingBuf_peek( &uart##uartNum##_tx, &dmaData ); \
+		if ( dmaCount > 0 ) \
+		{ \
+			connect_trace2("Connect uart%u Tx DMA %u bytes", uartNum, dmaCount ); \
+			uart##uartNum##_dma_count = dmaCount; \
+			DMA_TCD##uartNum##_SADDR = dmaData; \
+			DMA_TCD##uartNum##_CITER_ELINKNO = dmaCount; \
+			DMA_TCD##uartNum##_BITER_ELINKNO = dmaCount; \
+			DMA_TCD##uartNum##_CSR = DMA_TCD_CSR_INTMAJOR | DMA_TCD_CSR_DREQ; \
+			DMA_SERQ = uartNum; \
+		} \
 	} \
 }
 
-// Macro for processing UART Rx
-#define uart_processRx( uartNum ) \
+// Macro for completing a Tx DMA transfer, frees the sent bytes and starts the next transfer
+// Called from the DMA ISR, or polled from Connect_scan
+#define uart_pollTxDMA( uartNum ) \
 { \
-	if ( !( UART##uartNum##_S1 & UART_S1_RDRF ) ) \
-		return; \
-	uint8_t available = UART##uartNum##_RCFIFO; \
-	if ( available == 0 ) \
+	uint32_t primask = Connect_irqSave(); \
+	if ( uart##uartNum##_dma_count > 0 && ( DMA_TCD##uartNum##_CSR & DMA_TCD_CSR_DONE ) ) \
 	{ \
-		available = UART##uartNum##_D; \
-		UART##uartNum##_CFIFO = UART_CFIFO_RXFLUSH; \
-		return; \
-	} \
-	while ( available-- > 0 ) \
-	{ \
-		uint8_t byteRead = UART##uartNum##_D; \
-		printHex( byteRead ); \
-		print( "(" ); \
-		printInt8( available ); \
-		print( ") <-" ); \
-		switch ( uart##uartNum##_rx_status ) \
-		{ \
-		case UARTStatus_Wait: \
-			print(" SYN "); \
-			uart##uartNum##_rx_status = byteRead == 0x16 ? UARTStatus_SYN : UARTStatus_Wait; \
-			break; \
-		case UARTStatus_SYN: \
-			print(" SOH "); \
-			uart##uartNum##_rx_status = byteRead == 0x01 ? UARTStatus_SOH : UARTStatus_Wait; \
-			break; \
-		case UARTStatus_SOH: \
+		DMA_CDNE = uartNum; \
+		DMA_CINT = uartNum; \
+		RingBuf_consume( &uart##uartNum##_tx, uart##uartNum##_dma_count ); \
+		uart##uartNum##_tx_bytes += uart##uartNum##_dma_count; \
+		uart##uartNum##_dma_count = 0; \
+		if ( RingBuf_items( &uart##uartNum##_tx ) == 0 ) \
 		{ \
-			print(" CMD "); \
-			uint8_t byte = byteRead; \
-			if ( byte <= Animation ) \
-			{ \
-				uart##uartNum##_rx_status = UARTStatus_Command; \
-				uart##uartNum##_rx_command = byte; \
-				uart##uartNum##_rx_bytes_waiting = 0xFFFF; \
-			} \
-			else \
-			{ \
-				uart##uartNum##_rx_status = UARTStatus_Wait; \
-			} \
-			switch ( uart##uartNum##_rx_command ) \
-			{ \
-			case IdRequest: \
-				Connect_receive_IdRequest( 0, (uint16_t*)&uart##uartNum##_rx_bytes_waiting, uartNum ); \
-				uart##uartNum##_rx_status = UARTStatus_Wait; \
-				break; \
-			default: \
-				print("###"); \
-				break; \
-			} \
-			break; \
-		} \
-		case UARTStatus_Command: \
-		{ \
-			print(" CMD "); \
-			uint8_t (*rcvFunc)(uint8_t, uint16_t(*), uint8_t) = (uint8_t(*)(uint8_t, uint16_t(*), uint8_t))(Connect_receiveFunctions[ uart##uartNum##_rx_command ]); \
-			if ( rcvFunc( byteRead, (uint16_t*)&uart##uartNum##_rx_bytes_waiting, uartNum ) ) \
-				uart##uartNum##_rx_status = UARTStatus_Wait; \
-			break; \
-		} \
-		default: \
-			erro_msg("Invalid UARTStatus..."); \
-			uart##uartNum##_rx_status = UARTStatus_Wait; \
-			available++; \
-			continue; \
+			uint32_t latency = ( ARM_DWT_CYCCNT - uart##uartNum##_tx_queued ) / ( F_CPU / 1000000 ); \
+			uart##uartNum##_tx_latency = latency; \
+			if ( latency > uart##uartNum##_tx_latency_max ) \
+				uart##uartNum##_tx_latency_max = latency; \
 		} \
-		print( NL ); \
+		uart_startTxDMA( uartNum ); \
 	} \
+	Connect_irqRestore( primask ); \
 }
 
-// Macros for locking/unlock Tx buffers
-#define uart_lockTx( uartNum ) \
+// Macro for setting up the Tx DMA channel, 8 bit transfers from the ring buffer to the uart data register
+#define uart_setupTxDMA( uartNum ) \
 { \
-	while ( uart##uartNum##_tx_status == UARTStatus_Wait ); \
-	uart##uartNum##_tx_status = UARTStatus_Wait; \
+	DMAMUX0_CHCFG##uartNum = 0; \
+	DMA_TCD##uartNum##_SOFF = 1; \
+	DMA_TCD##uartNum##_ATTR = DMA_TCD_ATTR_SSIZE( DMA_TCD_ATTR_SIZE_8BIT ) | DMA_TCD_ATTR_DSIZE( DMA_TCD_ATTR_SIZE_8BIT ); \
+	DMA_TCD##uartNum##_NBYTES_MLNO = 1; \
+	DMA_TCD##uartNum##_SLAST = 0; \
+	DMA_TCD##uartNum##_DADDR = &UART##uartNum##_D; \
+	DMA_TCD##uartNum##_DOFF = 0; \
+	DMA_TCD##uartNum##_DLASTSGA = 0; \
+	DMAMUX0_CHCFG##uartNum = DMAMUX_SOURCE_UART##uartNum##_TX | DMAMUX_ENABLE; \
+	UART##uartNum##_C5 |= UART_C5_TDMAS; \
+	NVIC_SET_PRIORITY( IRQ_DMA_CH##uartNum, 32 ); \
+	NVIC_ENABLE_IRQ( IRQ_DMA_CH##uartNum ); \
 }
 
-#define uart_unlockTx( uartNum ) \
+// Macro for processing UART Rx
+// Bytes are passed to the link layer, which delivers verified command payloads to Connect_linkDeliver
+// The time spent is kept, as it adds to the interrupt latency of everything else
+#define uart_processRx( uartNum ) \
 { \
-	uart##uartNum##_tx_status = UARTStatus_Ready; \
+	uint32_t start = ARM_DWT_CYCCNT; \
+	if ( UART##uartNum##_S1 & UART_S1_RDRF ) \
+	{ \
+		uint8_t available = UART##uartNum##_RCFIFO; \
+		if ( available == 0 ) \
+		{ \
+			available = UART##uartNum##_D; \
+			UART##uartNum##_CFIFO = UART_CFIFO_RXFLUSH; \
+		} \
+		else \
+		{ \
+			uint32_t now = millis(); \
+			connect_trace2("Connect uart%u Rx %u bytes", uartNum, available ); \
+			while ( available-- > 0 ) \
+				ConnectFrame_receive( &Connect_links[ uartNum ], UART##uartNum##_D, now ); \
+		} \
+	} \
+	uint32_t cycles = ARM_DWT_CYCCNT - start; \
+	uart##uartNum##_rx_isr_cycles = cycles; \
+	if ( cycles > uart##uartNum##_rx_isr_max ) \
+		uart##uartNum##_rx_isr_max = cycles; \
 }
 
 
@@ -168,6 +176,9 @@ void cliFunc_connectMst ( char *args );
 void cliFunc_connectRst ( char *args );
 void cliFunc_connectSts ( char *args );
 
+// Connect receive function lookup
+extern void *Connect_receiveFunctions[];
+
 
 
 // ----- Variables -----
@@ -192,58 +203,122 @@ CLIDict_Def( uartConnectCLIDict, "UARTConnect Module Commands" ) = {
 uint8_t Connect_id = 255; // Invalid, unset
 uint8_t Connect_master = 0;
 
-
-// -- Rx Status Variables --
-
-volatile UARTStatus uart0_rx_status;
-volatile UARTStatus uart1_rx_status;
-volatile uint16_t uart0_rx_bytes_waiting;
-volatile uint16_t uart1_rx_bytes_waiting;
-volatile Command uart0_rx_command;
-volatile Command uart1_rx_command;
+// Animation sync hooks (see connect_scan.h)
+uint8_t (*Connect_animationEncode)( uint8_t *params ) = 0;
+void    (*Connect_animationApply)( uint8_t *params, uint8_t numParams, uint8_t id ) = 0;
 
 
-// -- Tx Status Variables --
+// -- Link Layer Variables --
 
-volatile UARTStatus uart0_tx_status;
-volatile UARTStatus uart1_tx_status;
+// Sequence numbers, retransmit window and error counters for each uart
+ConnectLink Connect_links[2];
 
 
 // -- Ring Buffer Variables --
 
 #define uart_buffer_size UARTConnectBufSize_define
-volatile uint8_t uart0_buffer_head;
-volatile uint8_t uart0_buffer_tail;
-volatile uint8_t uart0_buffer_items;
-volatile uint8_t uart0_buffer[uart_buffer_size];
-volatile uint8_t uart1_buffer_head;
-volatile uint8_t uart1_buffer_tail;
-volatile uint8_t uart1_buffer_items;
-volatile uint8_t uart1_buffer[uart_buffer_size];
+RingBuf_define( uart0_tx, uart_buffer_size );
+RingBuf_define( uart1_tx, uart_buffer_size );
 
 volatile uint8_t uarts_configured = 0;
 
 
-// -- Ring Buffer Convenience Functions --
+// -- Tx DMA Variables --
 
-void Connect_addBytes( uint8_t *buffer, uint8_t count, uint8_t uart )
+volatile uint16_t uart0_dma_count; // Bytes in the current transfer, 0 if idle
+volatile uint16_t uart1_dma_count;
+volatile uint32_t uart0_tx_bytes;  // Total bytes sent
+volatile uint32_t uart1_tx_bytes;
+volatile uint32_t uart0_tx_queued; // Cycle count when the buffer last went from empty to non-empty
+volatile uint32_t uart1_tx_queued;
+volatile uint32_t uart0_tx_latency; // us from queuing until the buffer was empty again, last and max
+volatile uint32_t uart1_tx_latency;
+volatile uint32_t uart0_tx_latency_max;
+volatile uint32_t uart1_tx_latency_max;
+
+// Rx ISR time, in cycles, last and max
+volatile uint32_t uart0_rx_isr_cycles;
+volatile uint32_t uart1_rx_isr_cycles;
+volatile uint32_t uart0_rx_isr_max;
+volatile uint32_t uart1_rx_isr_max;
+
+// Byte rate, from the previous connectSts
+uint32_t Connect_statsTime;
+uint32_t Connect_statsBytes[2];
+
+
+// -- Interrupt Mask Convenience Functions --
+
+// Disables interrupts, returning the previous mask
+// Needed as the buffers are used from both the main loop (sometimes with interrupts already disabled) and ISRs
+inline uint32_t Connect_irqSave()
 {
-	// Too big to fit into buffer
-	if ( count > uart_buffer_size )
-	{
-		erro_msg("Too big of a command to fit into the buffer...");
-		return;
-	}
+	uint32_t primask;
+	__asm__ volatile ( "mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory" );
+	return primask;
+}
+
+inline void Connect_irqRestore( uint32_t primask )
+{
+	__asm__ volatile ( "msr primask, %0" :: "r" (primask) : "memory" );
+}
 
+
+// -- Link Layer Functions --
+
+// Writes raw bytes to the uart Tx buffer, used by the link layer
+// Returns 0 if there isn't room for all of them
+uint8_t Connect_linkWrite( uint8_t uart, const uint8_t *data, uint16_t len )
+{
 	// Choose the uart
 	switch ( uart )
 	{
-	uart_addTxBuffer( 0 );
-	uart_addTxBuffer( 1 );
+	uart_writeTx( 0 );
+	uart_writeTx( 1 );
 	default:
-		erro_msg("Invalid UART to send from...");
+		connect_trace1("Connect invalid uart%u to send from", uart );
 		break;
 	}
+
+	return 0;
+}
+
+// Verified command payload, from the link layer (Rx ISR)
+// The command's receive function gets the arguments by reference, straight from the link layer Rx buffer
+// Returns 0 to refuse the payload, the link layer answers with a BSY and the sender sends it again later
+// Refused frames don't count towards the sender's retry limit, so they are never dropped
+uint8_t Connect_linkDeliver( uint8_t uart, uint8_t *payload, uint8_t len )
+{
+	if ( len == 0 || payload[0] > Animation )
+	{
+		connect_trace3("Connect uart%u invalid command %u (%u bytes)", uart, len ? payload[0] : 0, len );
+		return 1;
+	}
+
+	// Backpressure, ScanCode packets are only taken once all of their scan codes fit into the queue
+	// Dropping them instead could lose a release, leaving the key stuck on the master
+	if ( payload[0] == ScanCode && len >= 3 && payload[2] > Connect_scanCodeRoom() )
+	{
+		connect_trace2("Connect uart%u ScanCode refused, %u scan codes", uart, payload[2] );
+		return 0;
+	}
+
+	connect_trace3("Connect uart%u command %u (%u bytes)", uart, payload[0], len );
+
+	void (*rcvFunc)(uint8_t*, uint8_t, uint8_t) = (void(*)(uint8_t*, uint8_t, uint8_t))(Connect_receiveFunctions[ payload[0] ]);
+	rcvFunc( &payload[1], len - 1, uart );
+	return 1;
+}
+
+// Sends a command payload as a single frame
+// Returns 0 if the retransmit window is full (counted in the link's window full counter)
+uint8_t Connect_sendFrame( uint8_t uart, uint8_t *payload, uint8_t len )
+{
+	uint32_t primask = Connect_irqSave();
+	uint8_t sent = ConnectFrame_send( &Connect_links[ uart ], payload, len, millis() );
+	Connect_irqRestore( primask );
+
+	return sent;
 }
 
 
@@ -252,136 +327,171 @@ void Connect_addBytes( uint8_t *buffer, uint8_t count, uint8_t uart )
 // patternLen defines how many bytes should the incrementing pattern have
 void Connect_send_CableCheck( uint8_t patternLen )
 {
-	// Wait until the Tx buffers are ready, then lock them
-	uart_lockTx( 0 );
-	uart_lockTx( 1 );
-
-	// Prepare header
-	uint8_t header[] = { 0x16, 0x01, CableCheck, patternLen };
+	// Command, patternLen, then 0xD2 (11010010) for each argument
+	uint8_t payload[ ConnectFrame_MaxPayload ];
+	if ( patternLen > ConnectFrame_MaxPayload - 2 )
+		patternLen = ConnectFrame_MaxPayload - 2;
 
-	// Send header
-	Connect_addBytes( header, sizeof( header ), 1 ); // Master
-	Connect_addBytes( header, sizeof( header ), 0 ); // Slave
-
-	// Send 0xD2 (11010010) for each argument
-	uint8_t value = 0xD2;
+	payload[0] = CableCheck;
+	payload[1] = patternLen;
 	for ( uint8_t c = 0; c < patternLen; c++ )
 	{
-		Connect_addBytes( &value, 1, 1 ); // Master
-		Connect_addBytes( &value, 1, 0 ); // Slave
+		payload[ c + 2 ] = 0xD2;
 	}
 
-	// Release Tx buffers
-	uart_unlockTx( 0 );
-	uart_unlockTx( 1 );
+	Connect_sendFrame( 1, payload, patternLen + 2 ); // Master
+	Connect_sendFrame( 0, payload, patternLen + 2 ); // Slave
 }
 
 void Connect_send_IdRequest()
 {
-	// Lock master bound Tx
-	uart_lockTx( 1 );
-
-	// Prepare header
-	uint8_t header[] = { 0x16, 0x01, IdRequest };
-
-	// Send header
-	Connect_addBytes( header, sizeof( header ), 1 ); // Master
-
-	// Unlock Tx
-	uart_unlockTx( 1 );
+	uint8_t payload[] = { IdRequest };
+	Connect_sendFrame( 1, payload, sizeof( payload ) ); // Master
 }
 
 // id is the value the next slave should enumerate as
 void Connect_send_IdEnumeration( uint8_t id )
 {
-	// Lock slave bound Tx
-	uart_lockTx( 0 );
-
-	// Prepare header
-	uint8_t header[] = { 0x16, 0x01, IdEnumeration, id };
-
-	// Send header
-	Connect_addBytes( header, sizeof( header ), 0 ); // Slave
-
-	// Unlock Tx
-	uart_unlockTx( 0 );
+	uint8_t payload[] = { IdEnumeration, id };
+	Connect_sendFrame( 0, payload, sizeof( payload ) ); // Slave
 }
 
 // id is the currently assigned id to the slave
 void Connect_send_IdReport( uint8_t id )
 {
-	// Lock master bound Tx
-	uart_lockTx( 1 );
-
-	// Prepare header
-	uint8_t header[] = { 0x16, 0x01, IdReport, id };
-
-	// Send header
-	Connect_addBytes( header, sizeof( header ), 1 ); // Master
-
-	// Unlock Tx
-	uart_unlockTx( 1 );
+	uint8_t payload[] = { IdReport, id };
+	Connect_sendFrame( 1, payload, sizeof( payload ) ); // Master
 }
 
 // id is the currently assigned id to the slave
 // scanCodeStateList is an array of [scancode, state]'s (8 bit values)
 // numScanCodes is the number of scan codes to parse from array
-void Connect_send_ScanCode( uint8_t id, TriggerGuide *scanCodeStateList, uint8_t numScanCodes )
+// Returns 0 if the packet couldn't be sent (too many scan codes, or the window is full)
+uint8_t Connect_send_ScanCode( uint8_t id, TriggerGuide *scanCodeStateList, uint8_t numScanCodes )
 {
-	// Lock master bound Tx
-	uart_lockTx( 1 );
+	uint8_t payload[ ConnectFrame_MaxPayload ];
+	uint16_t len = 3 + numScanCodes * TriggerGuideSize;
+	if ( len > ConnectFrame_MaxPayload )
+		return 0;
+
+	payload[0] = ScanCode;
+	payload[1] = id;
+	payload[2] = numScanCodes;
+	memcpy( &payload[3], scanCodeStateList, numScanCodes * TriggerGuideSize );
 
-	// Prepare header
-	uint8_t header[] = { 0x16, 0x01, ScanCode, id, numScanCodes };
+	return Connect_sendFrame( 1, payload, len ); // Master
+}
 
-	// Send header
-	Connect_addBytes( header, sizeof( header ), 1 ); // Master
+// id is the id of the node that originated the command (the master)
+// paramList is the animation sync, as filled in by Connect_animationEncode
+// numParams is the number of bytes in paramList
+void Connect_send_Animation( uint8_t id, uint8_t *paramList, uint8_t numParams )
+{
+	uint8_t payload[ ConnectFrame_MaxPayload ];
+	if ( numParams > ConnectFrame_MaxPayload - 3 )
+		numParams = ConnectFrame_MaxPayload - 3;
 
-	// Send each of the scan codes
-	Connect_addBytes( (uint8_t*)scanCodeStateList, numScanCodes * TriggerGuideSize, 1 ); // Master
+	payload[0] = Animation;
+	payload[1] = id;
+	payload[2] = numParams;
+	memcpy( &payload[3], paramList, numParams );
 
-	// Unlock Tx
-	uart_unlockTx( 1 );
+	Connect_sendFrame( 0, payload, numParams + 3 ); // Slave
 }
 
-// id is the currently assigned id to the slave
-// paramList is an array of [param, value]'s (8 bit values)
-// numParams is the number of params to parse from the array
-void Connect_send_Animation( uint8_t id, uint8_t *paramList, uint8_t numParams )
+void Connect_send_Idle( uint8_t num )
 {
-	// Lock slave bound Tx
-	uart_lockTx( 0 );
+	// Send n number of idles to reset link status (if in a bad state)
+	// Idles aren't framed, and are skipped if the Tx buffer is full
+	uint8_t value = ConnectFrame_SYN;
+	for ( uint8_t c = 0; c < num; c++ )
+	{
+		Connect_linkWrite( 1, &value, 1 ); // Master
+		Connect_linkWrite( 0, &value, 1 ); // Slave
+	}
+}
+
 
-	// Prepare header
-	uint8_t header[] = { 0x16, 0x01, Animation, id, numParams };
+// -- Scan Code Aggregation --
 
-	// Send header
-	Connect_addBytes( header, sizeof( header ), 0 ); // Slave
+// Scan codes waiting for the next ScanCode packet to the master
+// Both this node's scan codes and the ones received from further down the chain are merged here
+// Scan codes are never dropped, when the queue is full they wait where they are (backpressure)
+//  Local scan codes are kept by the caller, received ScanCode packets aren't acknowledged until they fit
+// Holds two packets, so a full packet from further down the chain fits while this node's own are waiting
+#define Connect_scanCodePacketSize ( ( ConnectFrame_MaxPayload - 3 ) / TriggerGuideSize )
+#define Connect_scanCodeQueueSize  ( Connect_scanCodePacketSize * 2 )
+TriggerGuide Connect_scanCodeQueue[ Connect_scanCodeQueueSize ];
+volatile uint8_t  Connect_scanCodeQueueLen = 0;
+volatile uint32_t Connect_scanCodeQueueFull = 0;
 
-	// Send each of the scan codes
-	Connect_addBytes( paramList, numParams, 0 ); // Slave
+// Number of scan codes Connect_queueScanCodes will take right now
+uint8_t Connect_scanCodeRoom()
+{
+	// The master passes them straight to the Macro module
+	if ( Connect_master )
+		return 0xFF;
 
-	// Unlock Tx
-	uart_unlockTx( 0 );
+	return Connect_scanCodeQueueSize - Connect_scanCodeQueueLen;
 }
 
-void Connect_send_Idle( uint8_t num )
+// Queues scan codes for the master, all or nothing
+// On the master they go directly to the Macro module
+// Returns 0 if there isn't room for all of them, keep them and try again next scan
+// May be called from the Rx ISRs
+uint8_t Connect_queueScanCodes( TriggerGuide *scanCodeStateList, uint8_t numScanCodes )
 {
-	// Wait until the Tx buffers are ready, then lock them
-	uart_lockTx( 0 );
-	uart_lockTx( 1 );
+	if ( Connect_master )
+	{
+		Macro_triggerState( scanCodeStateList, numScanCodes );
+		return 1;
+	}
 
-	// Send n number of idles to reset link status (if in a bad state)
-	uint8_t value = 0x16;
-	for ( uint8_t c = 0; c < num; c++ )
+	uint32_t primask = Connect_irqSave();
+	if ( numScanCodes > Connect_scanCodeQueueSize - Connect_scanCodeQueueLen )
 	{
-		Connect_addBytes( &value, 1, 1 ); // Master
-		Connect_addBytes( &value, 1, 0 ); // Slave
+		Connect_scanCodeQueueFull++;
+		Connect_irqRestore( primask );
+		return 0;
 	}
+	memcpy( &Connect_scanCodeQueue[ Connect_scanCodeQueueLen ], scanCodeStateList, numScanCodes * TriggerGuideSize );
+	Connect_scanCodeQueueLen += numScanCodes;
+	Connect_irqRestore( primask );
 
-	// Release Tx buffers
-	uart_unlockTx( 0 );
-	uart_unlockTx( 1 );
+	return 1;
+}
+
+// Sends the queued scan codes (oldest first) as a single ScanCode packet
+// Called once per scan, so the master receives at most one packet per node per scan no matter how long the chain is
+// The packet is built directly in the link layer's retransmit window, no intermediate copies
+void Connect_flushScanCodes()
+{
+	// Nothing to send, or not enumerated yet
+	if ( Connect_scanCodeQueueLen == 0 || Connect_id == 255 )
+		return;
+
+	uint32_t primask = Connect_irqSave();
+
+	// Retransmit window is full, keep the scan codes for the next scan
+	uint8_t *payload = ConnectFrame_reserve( &Connect_links[1] );
+	if ( payload )
+	{
+		uint8_t numScanCodes = Connect_scanCodeQueueLen;
+		if ( numScanCodes > Connect_scanCodePacketSize )
+			numScanCodes = Connect_scanCodePacketSize;
+
+		payload[0] = ScanCode;
+		payload[1] = Connect_id;
+		payload[2] = numScanCodes;
+		memcpy( &payload[3], Connect_scanCodeQueue, numScanCodes * TriggerGuideSize );
+		ConnectFrame_commit( &Connect_links[1], 3 + numScanCodes * TriggerGuideSize, millis() ); // Master
+
+		// The rest go in the next packet
+		Connect_scanCodeQueueLen -= numScanCodes;
+		memmove( Connect_scanCodeQueue, &Connect_scanCodeQueue[ numScanCodes ], Connect_scanCodeQueueLen * TriggerGuideSize );
+	}
+
+	Connect_irqRestore( primask );
 }
 
 
@@ -393,78 +503,42 @@ uint32_t Connect_cableFaultsSlave = 0;
 uint8_t  Connect_cableOkMaster = 0;
 uint8_t  Connect_cableOkSlave = 0;
 
-uint8_t Connect_receive_CableCheck( uint8_t byte, uint16_t *pending_bytes, uint8_t to_master )
+// data is [patternLen, 0xD2 x patternLen]
+void Connect_receive_CableCheck( uint8_t *data, uint8_t len, uint8_t to_master )
 {
-	// Check if this is the first byte
-	if ( *pending_bytes == 0xFFFF )
-	{
-		dbug_msg("PENDING SET -> ");
-		printHex( byte );
-		print(" ");
-		*pending_bytes = byte;
-		printHex( *pending_bytes );
-		print( NL );
-	}
-	// Verify byte
-	else
-	{
-		(*pending_bytes)--;
+	connect_trace2("Connect CableCheck, to master %u, %u bytes", to_master, len );
 
-		// The argument bytes are always 0xD2 (11010010)
-		if ( byte != 0xD2 )
+	// The argument bytes are always 0xD2 (11010010)
+	uint8_t ok = len > 0 && data[0] == len - 1;
+	for ( uint8_t c = 1; c < len && ok; c++ )
+	{
+		if ( data[ c ] != 0xD2 )
 		{
-			warn_print("Cable Fault!");
-
-			// Check which side of the chain
-			if ( to_master )
-			{
-				Connect_cableFaultsMaster++;
-				Connect_cableOkMaster = 0;
-				print(" Master ");
-			}
-			else
-			{
-				Connect_cableFaultsSlave++;
-				Connect_cableOkSlave = 0;
-				print(" Slave ");
-			}
-			printHex( byte );
-			print( NL );
-
-			// Signal that the command should wait for a SYN again
-			return 1;
+			connect_trace2("Connect cable fault, to master %u, got %02x", to_master, data[ c ] );
+			ok = 0;
 		}
 	}
 
-	// If cable check was successful, set cable ok
-	if ( *pending_bytes == 0 )
+	// Check which side of the chain
+	if ( to_master )
 	{
-		if ( to_master )
-		{
-			Connect_cableOkMaster = 1;
-		}
-		else
-		{
-			Connect_cableOkSlave = 1;
-		}
+		Connect_cableFaultsMaster += !ok;
+		Connect_cableOkMaster = ok;
+	}
+	else
+	{
+		Connect_cableFaultsSlave += !ok;
+		Connect_cableOkSlave = ok;
 	}
-	dbug_msg("CABLECHECK RECEIVE - ");
-	printHex( byte );
-	print(" ");
-	printHex( *pending_bytes );
-	print(NL);
-
-	// Check whether the cable check has finished
-	return *pending_bytes == 0 ? 1 : 0;
 }
 
-uint8_t Connect_receive_IdRequest( uint8_t byte, uint16_t *pending_bytes, uint8_t to_master )
+void Connect_receive_IdRequest( uint8_t *data, uint8_t len, uint8_t to_master )
 {
-	dbug_print("IdRequest");
+	connect_trace0("Connect IdRequest");
 	// Check the directionality
 	if ( !to_master )
 	{
-		erro_print("Invalid IdRequest direction...");
+		connect_trace0("Connect invalid IdRequest direction");
 	}
 
 	// Check if master, begin IdEnumeration
@@ -479,17 +553,20 @@ uint8_t Connect_receive_IdRequest( uint8_t byte, uint16_t *pending_bytes, uint8_
 	{
 		Connect_send_IdRequest();
 	}
-
-	return 1;
 }
 
-uint8_t Connect_receive_IdEnumeration( uint8_t id, uint16_t *pending_bytes, uint8_t to_master )
+// data is [id]
+void Connect_receive_IdEnumeration( uint8_t *data, uint8_t len, uint8_t to_master )
 {
-	dbug_print("IdEnumeration");
+	connect_trace1("Connect IdEnumeration, %u bytes", len );
+	if ( len < 1 )
+		return;
+	uint8_t id = data[0];
+
 	// Check the directionality
 	if ( to_master )
 	{
-		erro_print("Invalid IdEnumeration direction...");
+		connect_trace1("Connect invalid IdEnumeration direction, id %u", id );
 	}
 
 	// Set the device id
@@ -503,118 +580,80 @@ uint8_t Connect_receive_IdEnumeration( uint8_t id, uint16_t *pending_bytes, uint
 	{
 		Connect_send_IdEnumeration( id + 1 );
 	}
-
-	return 1;
 }
 
-uint8_t Connect_receive_IdReport( uint8_t id, uint16_t *pending_bytes, uint8_t to_master )
+// data is [id]
+void Connect_receive_IdReport( uint8_t *data, uint8_t len, uint8_t to_master )
 {
-	dbug_print("IdReport");
+	connect_trace1("Connect IdReport, %u bytes", len );
+	if ( len < 1 )
+		return;
+	uint8_t id = data[0];
+
 	// Check the directionality
 	if ( !to_master )
 	{
-		erro_print("Invalid IdRequest direction...");
+		connect_trace1("Connect invalid IdReport direction, id %u", id );
 	}
 
 	// Track Id response if master
 	if ( Connect_master )
 	{
 		// TODO, setup id's
-		info_msg("Id Reported: ");
-		printHex( id );
-		print( NL );
-		return 1;
+		connect_trace1("Connect id reported: %u", id );
 	}
 	// Propagate id if yet another slave
 	else
 	{
 		Connect_send_IdReport( id );
 	}
-
-	return 1;
 }
 
-// - Scan Code Variables -
-TriggerGuide Connect_receive_ScanCodeBuffer;
-uint8_t Connect_receive_ScanCodeBufferPos;
-uint8_t Connect_receive_ScanCodeDeviceId;
-
-uint8_t Connect_receive_ScanCode( uint8_t byte, uint16_t *pending_bytes, uint8_t to_master )
+// data is [id, numScanCodes, TriggerGuide x numScanCodes]
+void Connect_receive_ScanCode( uint8_t *data, uint8_t len, uint8_t to_master )
 {
-	dbug_print("ScanCode");
 	// Check the directionality
 	if ( !to_master )
 	{
-		erro_print("Invalid ScanCode direction...");
+		connect_trace0("Connect invalid ScanCode direction");
 	}
 
-	// Master node, trigger scan codes
-	if ( Connect_master ) switch ( (*pending_bytes)-- )
+	if ( len < 2 || len - 2 != data[1] * TriggerGuideSize )
 	{
-	case 0xFFFF: // Device Id
-		Connect_receive_ScanCodeDeviceId = byte;
-		break;
-
-	case 0xFFFE: // Number of TriggerGuides in bytes (byte * 3)
-		*pending_bytes = byte * 3;
-		Connect_receive_ScanCodeBufferPos = 0;
-		break;
-
-	default:
-		// Set the specific TriggerGuide entry
-		((uint8_t*)&Connect_receive_ScanCodeBuffer)[ Connect_receive_ScanCodeBufferPos++ ] = byte;
-
-		// Reset the BufferPos if higher than 3
-		// And send the TriggerGuide to the Macro Module
-		if ( Connect_receive_ScanCodeBufferPos > 3 )
-		{
-			Connect_receive_ScanCodeBufferPos = 0;
-			Macro_triggerState( &Connect_receive_ScanCodeBuffer, 1 );
-		}
-
-		break;
+		connect_trace1("Connect invalid ScanCode length, %u bytes", len );
+		return;
 	}
-	// Propagate ScanCode packet
-	else switch ( (*pending_bytes)-- )
-	{
-	case 0xFFFF: // Device Id
-	{
-		Connect_receive_ScanCodeDeviceId = byte;
 
-		// Lock the master Tx buffer
-		uart_lockTx( 1 );
+	// Master node, send them to the Macro Module
+	// Otherwise merge them into this node's next ScanCode packet (Connect_linkDeliver made sure they fit)
+	Connect_queueScanCodes( (TriggerGuide*)&data[2], data[1] );
+}
 
-		// Send header + Id byte
-		uint8_t header[] = { 0x16, 0x01, ScanCode, byte };
-		Connect_addBytes( header, sizeof( header ), 1 ); // Master
-		break;
+// data is [id, numParams, param x numParams]
+void Connect_receive_Animation( uint8_t *data, uint8_t len, uint8_t to_master )
+{
+	// Check the directionality, animation syncs only travel away from the master
+	if ( to_master )
+	{
+		connect_trace0("Connect invalid Animation direction");
+		return;
 	}
-	case 0xFFFE: // Number of TriggerGuides in bytes (byte * 3)
-		*pending_bytes = byte * 3;
-		Connect_receive_ScanCodeBufferPos = 0;
-
-		// Pass through byte
-		Connect_addBytes( &byte, 1, 1 ); // Master
-		break;
-
-	default:
-		// Pass through byte
-		Connect_addBytes( &byte, 1, 1 ); // Master
 
-		// Unlock Tx Buffer after sending last byte
-		if ( *pending_bytes == 0 )
-			uart_unlockTx( 1 );
-		break;
+	if ( len < 2 || len - 2 != data[1] )
+	{
+		connect_trace1("Connect invalid Animation length, %u bytes", len );
+		return;
 	}
 
-	// Check whether the scan codes have finished sending
-	return *pending_bytes == 0 ? 1 : 0;
-}
+	// Render locally in step with the master
+	if ( Connect_animationApply )
+		Connect_animationApply( &data[2], data[1], Connect_id );
 
-uint8_t Connect_receive_Animation( uint8_t byte, uint16_t *pending_bytes, uint8_t to_master )
-{
-	dbug_print("Animation");
-	return 1;
+	// Propagate to the next slave if the connection is ok
+	if ( Connect_cableOkSlave )
+	{
+		Connect_send_Animation( data[0], &data[2], data[1] );
+	}
 }
 
 
@@ -637,6 +676,18 @@ void *Connect_receiveFunctions[] = {
 
 // ----- Interrupt Functions -----
 
+// UART0 Tx DMA ISR
+void dma_ch0_isr()
+{
+	uart_pollTxDMA( 0 );
+}
+
+// UART1 Tx DMA ISR
+void dma_ch1_isr()
+{
+	uart_pollTxDMA( 1 );
+}
+
 // Master / UART0 ISR
 void uart0_status_isr()
 {
@@ -658,28 +709,35 @@ void uart1_status_isr()
 // Resets the state of the UART buffers and state variables
 void Connect_reset()
 {
-	// Rx Status Variables
-	uart0_rx_status = UARTStatus_Wait;
-	uart1_rx_status = UARTStatus_Wait;
-	uart0_rx_bytes_waiting = 0;
-	uart1_rx_bytes_waiting = 0;
+	uint32_t primask = Connect_irqSave();
 
-	// Tx Status Variables
-	uart0_tx_status = UARTStatus_Ready;
-	uart1_tx_status = UARTStatus_Ready;
+	// Link Layer Variables
+	ConnectFrame_reset( &Connect_links[0], 0 );
+	ConnectFrame_reset( &Connect_links[1], 1 );
+
+	// Stop any Tx DMA transfers
+	DMA_CERQ = 0;
+	DMA_CERQ = 1;
+	DMA_CDNE = 0;
+	DMA_CDNE = 1;
+	uart0_dma_count = 0;
+	uart1_dma_count = 0;
 
 	// Ring Buffer Variables
-	uart0_buffer_head = 0;
-	uart0_buffer_tail = 0;
-	uart0_buffer_items = 0;
-	uart1_buffer_head = 0;
-	uart1_buffer_tail = 0;
-	uart1_buffer_items = 0;
+	RingBuf_reset( &uart0_tx );
+	RingBuf_reset( &uart1_tx );
+
+	// Rx ISR time
+	uart0_rx_isr_max = 0;
+	uart1_rx_isr_max = 0;
+
+	Connect_irqRestore( primask );
 }
 
 
 // Setup connection to other side
-// - Only supports a single slave and master
+// - Any number of nodes may be chained, UART1 towards the master and UART0 towards the next slave
+// - Nodes merge the scan codes of the slaves behind them into their own ScanCode packets
 // - If USB has been initiallized at this point, this side is the master
 // - If both sides assert master, flash error leds
 void Connect_setup( uint8_t master )
@@ -724,8 +782,7 @@ void Connect_setup( uint8_t master )
 	UART0_C1 = UART_C1_M | UART_C1_PE | UART_C1_ILT;
 	UART1_C1 = UART_C1_M | UART_C1_PE | UART_C1_ILT;
 
-	// Number of bytes in FIFO before TX Interrupt
-	// TODO Set 0
+	// Number of bytes in FIFO before TX DMA request
 	UART0_TWFIFO = 1;
 	UART1_TWFIFO = 1;
 
@@ -747,10 +804,21 @@ void Connect_setup( uint8_t master )
 	UART0_C3 |= 0x00;
 	UART1_C3 |= 0x00;
 
-	// TX Enabled, RX Enabled, RX Interrupt Enabled
-	// UART_C2_TE UART_C2_RE UART_C2_RIE
-	UART0_C2 = UART_C2_TE | UART_C2_RE | UART_C2_RIE;
-	UART1_C2 = UART_C2_TE | UART_C2_RE | UART_C2_RIE;
+	// Tx DMA setup
+	// Priority is higher than the UART ISRs so Tx keeps draining while Rx is processed
+	SIM_SCGC6 |= SIM_SCGC6_DMAMUX;
+	SIM_SCGC7 |= SIM_SCGC7_DMA;
+	uart_setupTxDMA( 0 );
+	uart_setupTxDMA( 1 );
+
+	// Cycle counter, used for Tx latency
+	ARM_DEMCR |= ARM_DEMCR_TRCENA;
+	ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+
+	// TX Enabled, RX Enabled, RX Interrupt Enabled, TX DMA Enabled
+	// UART_C2_TE UART_C2_RE UART_C2_RIE UART_C2_TIE
+	UART0_C2 = UART_C2_TE | UART_C2_RE | UART_C2_RIE | UART_C2_TIE;
+	UART1_C2 = UART_C2_TE | UART_C2_RE | UART_C2_RIE | UART_C2_TIE;
 
 	// Add interrupts to the vector table
 	NVIC_ENABLE_IRQ( IRQ_UART0_STATUS );
@@ -771,12 +839,94 @@ void Connect_setup( uint8_t master )
 // - SyncEvent is also blocking until sent
 void Connect_scan()
 {
-	// Check if Tx Buffers are empty and the Tx Ring buffers have data to send
-	// This happens if there was previously nothing to send
-	if ( uart0_buffer_items > 0 && UART0_TCFIFO == 0 )
-		uart_fillTxFifo( 0 );
-	if ( uart1_buffer_items > 0 && UART1_TCFIFO == 0 )
-		uart_fillTxFifo( 1 );
+	// Send this scan's aggregated scan codes towards the master
+	Connect_flushScanCodes();
+
+	// Master, broadcast the animation frame clock when it's due
+	if ( Connect_master && Connect_animationEncode && Connect_cableOkSlave )
+	{
+		uint8_t params[ ConnectFrame_MaxPayload - 3 ];
+		uint8_t numParams = Connect_animationEncode( params );
+		if ( numParams > 0 )
+			Connect_send_Animation( Connect_id, params, numParams );
+	}
+
+	// Retransmit timers, and frames that didn't fit into the Tx buffers yet
+	// The link layer isn't reentrant, the Rx ISRs use it too (ACKs, NAKs and propagated commands)
+	uint32_t now = millis();
+	uint32_t primask = Connect_irqSave();
+	ConnectFrame_process( &Connect_links[0], now );
+	ConnectFrame_process( &Connect_links[1], now );
+	Connect_irqRestore( primask );
+
+	// Tx is handled by DMA, just make sure a completed transfer wasn't missed
+	uart_pollTxDMA( 0 );
+	uart_pollTxDMA( 1 );
+}
+
+
+// Tx byte count, byte rate since the previous connectSts, and latency
+void Connect_printTxStats( uint8_t uart, uint32_t bytes, uint32_t latency, uint32_t latencyMax )
+{
+	uint32_t elapsed = millis() - Connect_statsTime;
+
+	print( NL "\tTx Bytes:\t");
+	printInt32( bytes );
+	print( NL "\tTx Rate:\t");
+	printInt32( elapsed > 0 ? (uint64_t)( bytes - Connect_statsBytes[ uart ] ) * 1000 / elapsed : 0 );
+	print(" B/s");
+	print( NL "\tTx Latency:\t");
+	printInt32( latency );
+	print(" us (max ");
+	printInt32( latencyMax );
+	print(" us)");
+
+	Connect_statsBytes[ uart ] = bytes;
+}
+
+// Rx ISR time, last and max
+void Connect_printRxIsr( uint32_t cycles, uint32_t max )
+{
+	print( NL "\tRx ISR:\t\t");
+	printInt32( cycles / ( F_CPU / 1000000 ) );
+	print(" us (max ");
+	printInt32( max / ( F_CPU / 1000000 ) );
+	print(" us)");
+}
+
+// Link layer frame and error counters
+void Connect_printLinkStats( uint8_t uart )
+{
+	ConnectLink *link = &Connect_links[ uart ];
+
+	print( NL "\tFrames Tx/Rx:\t");
+	printInt32( link->framesSent );
+	print("/");
+	printInt32( link->framesReceived );
+	print( NL "\tCRC Errors:\t");
+	printInt32( link->crcErrors );
+	print( NL "\tNAKs Tx/Rx:\t");
+	printInt32( link->naksSent );
+	print("/");
+	printInt32( link->naksReceived );
+	print( NL "\tRetransmits:\t");
+	printInt32( link->retransmits );
+	print( NL "\tTimeouts:\t");
+	printInt32( link->timeouts );
+	print( NL "\tDuplicates:\t");
+	printInt32( link->duplicates );
+	print( NL "\tDropped:\t");
+	printInt32( link->dropped );
+	print( NL "\tRefused/Busy:\t");
+	printInt32( link->refused );
+	print("/");
+	printInt32( link->busy );
+	print( NL "\tWindow Full:\t");
+	printInt32( link->windowFull );
+	print( NL "\tResyncs:\t");
+	printInt32( link->resyncs );
+	print( NL "\tPending:\t");
+	printInt8( ConnectFrame_pending( link ) );
 }
 
 
@@ -888,21 +1038,25 @@ void cliFunc_connectSts( char* args )
 	print( Connect_master ? "Master" : "Slave" );
 	print( NL "Device Id:\t" );
 	printHex( Connect_id );
+	print( NL "Scan Code Queue:\t" );
+	printInt8( Connect_scanCodeQueueLen );
+	print( NL "Scan Code Queue Full:\t" );
+	printInt32( Connect_scanCodeQueueFull );
 	print( NL "Master <=" NL "\tStatus:\t");
 	printHex( Connect_cableOkMaster );
 	print( NL "\tFaults:\t");
 	printHex( Connect_cableFaultsMaster );
-	print( NL "\tRx:\t");
-	printHex( uart1_rx_status );
-	print( NL "\tTx:\t");
-	printHex( uart1_tx_status );
+	Connect_printLinkStats( 1 );
+	Connect_printRxIsr( uart1_rx_isr_cycles, uart1_rx_isr_max );
+	Connect_printTxStats( 1, uart1_tx_bytes, uart1_tx_latency, uart1_tx_latency_max );
 	print( NL "Slave <=" NL "\tStatus:\t");
 	printHex( Connect_cableOkSlave );
 	print( NL "\tFaults:\t");
 	printHex( Connect_cableFaultsSlave );
-	print( NL "\tRx:\t");
-	printHex( uart0_rx_status );
-	print( NL "\tTx:\t");
-	printHex( uart0_tx_status );
+	Connect_printLinkStats( 0 );
+	Connect_printRxIsr( uart0_rx_isr_cycles, uart0_rx_isr_max );
+	Connect_printTxStats( 0, uart0_tx_bytes, uart0_tx_latency, uart0_tx_latency_max );
+
+	Connect_statsTime = millis();
 }
 
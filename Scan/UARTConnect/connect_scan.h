@@ -35,15 +35,6 @@ typedef enum Command {
 	Animation     = 5, // Master trigger animation event (same command is sent back to master when ready)
 } Command;
 
-// UART Rx/Tx Status
-typedef enum UARTStatus {
-	UARTStatus_Wait    = 0, // Waiting  Rx: for SYN  Tx: for current command copy to finish
-	UARTStatus_SYN     = 1, // Rx: SYN Received, waiting for SOH
-	UARTStatus_SOH     = 2, // Rx: SOH Received, waiting for Command
-	UARTStatus_Command = 3, // Rx: Command Received, waiting for data
-	UARTStatus_Ready   = 4, // Tx: Ready to receive commands
-} UARTStatus;
-
 
 
 // ----- Structs -----
@@ -95,13 +86,12 @@ typedef struct ScanCodeCommand {
 } ScanCodeCommand;
 
 // Animation Command
-// Initiated by the master whenever an animation id should modify it's state
-// Then after the leaf slave node receives the command, send it back to the master
-// On the way back, each device can begin the animation adjustment
+// Broadcast by the master to keep the LED animations of every node in step
+// Each slave hands the params to Connect_animationApply, then passes the command on down the chain
+// The params are a compact frame clock (animation, frame number, frame rate), not pixel data, every
+// node renders its own frames locally, so the link is left free for scan codes
 //
-// The master->leaf command should indicate to each device that it should finish sending the
-// current slave->master data and wait for the leaf->master command
-// This allows for a tighter synchronization of animation events
+// Nothing is sent back, the link latency (around a ms per hop) is well under a frame period
 typedef struct AnimationCommand {
 	Command command;
 	uint8_t animationId;
@@ -116,3 +106,14 @@ typedef struct AnimationCommand {
 void Connect_setup( uint8_t master );
 void Connect_scan();
 
+uint8_t Connect_scanCodeRoom();
+uint8_t Connect_queueScanCodes( TriggerGuide *scanCodeStateList, uint8_t numScanCodes );
+
+// Animation sync hooks, set by the scan module when there is an LED module to keep in step, e.g.
+//  Connect_animationEncode = LED_animationSyncEncode;
+//  Connect_animationApply  = LED_animationSyncApply;
+// encode - Master, polled by Connect_scan, fills in params and returns their length if a sync is due (0 otherwise)
+// apply  - Slave, called with the params received from the master and the id of this node
+extern uint8_t (*Connect_animationEncode)( uint8_t *params );
+extern void    (*Connect_animationApply)( uint8_t *params, uint8_t numParams, uint8_t id );
+
@@ -0,0 +1,359 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host loopback harness for the UARTConnect link layer (connect_frame.c)
+// Two links are connected back to back by simulated UART wires, one millisecond at a time.
+// Both sides stream frames at each other while the wires flip random bits.
+// Each payload starts with a counter and the rest is derived from it, so the receiver can tell
+// whether a corrupted frame got through, or frames were duplicated or reordered.
+// Frames are only allowed to go missing if the sender gave up on them (dropped).
+// Receivers also refuse some deliveries at random, as a full scan code queue would.
+//
+// Before that, a busy test refuses every delivery for much longer than the sender's retry limit,
+// on a clean wire. Refused frames must not be acknowledged or given up on, and once the receiver
+// takes them again, every frame must be delivered exactly once, in order.
+//
+// Build (from this directory):
+//   cc -O2 -I. -I.. -o connect_loopback connect_loopback.c ../connect_frame.c
+//
+// Usage:
+//   ./connect_loopback [bit error rate] [seconds] [baud] [refuse rate]
+
+// ----- Includes -----
+
+// Compiler Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Local Includes
+#include "connect_frame.h"
+
+
+
+// ----- Defines -----
+
+// Matches the Tx ring buffer, writes that don't fit are refused
+#define WireSize UARTConnectBufSize_define
+
+// Busy test, the receiver refuses everything from BusyStart for BusyTime ms
+// Far longer than UARTConnectRetries * UARTConnectRetransmit, when the sender used to give up
+#define BusyStart 100
+#define BusyTime  1000
+
+
+
+// ----- Structs -----
+
+// One direction of the cable
+typedef struct Wire {
+	uint8_t  data[ WireSize ];
+	uint16_t head;
+	uint16_t items;
+	uint32_t overflows;
+	uint32_t bitErrors;
+} Wire;
+
+// Payload checking on the receiving side
+typedef struct Check {
+	uint32_t next;      // Next counter expected
+	uint32_t sent;      // Counter of the next payload to send
+	uint32_t delivered;
+	uint32_t corrupted; // Passed the CRC but the content was wrong
+	uint32_t reordered; // Duplicated or went backwards
+	uint32_t missing;   // Skipped over
+	uint32_t refused;   // Deliveries refused, the frame must come again
+	uint32_t busyUntil; // Refuse every delivery until then (ms)
+	uint32_t sentTime[ 256 ]; // Latency tracking, indexed by counter
+	uint32_t latencyMax;
+	uint64_t latencyTotal;
+} Check;
+
+
+
+// ----- Variables -----
+
+ConnectLink links[2];
+Wire wires[2]; // wires[n] carries what links[n] sends
+Check checks[2]; // checks[n] tracks what links[n] receives
+
+double bitErrorRate;
+double refuseRate;
+uint32_t now;
+uint32_t rng = 0x12345678;
+
+
+
+// ----- Functions -----
+
+// xorshift
+uint32_t next( uint32_t *state )
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+double uniform()
+{
+	return ( next( &rng ) >> 8 ) / (double)( 1 << 24 );
+}
+
+// Payload for a given counter
+uint8_t payloadFill( uint32_t counter, uint8_t *payload )
+{
+	uint32_t state = counter * 2654435761u + 1;
+	uint8_t len = 4 + next( &state ) % ( ConnectFrame_MaxPayload - 4 + 1 );
+	memcpy( payload, &counter, 4 );
+	for ( uint8_t c = 4; c < len; c++ )
+		payload[ c ] = next( &state );
+	return len;
+}
+
+
+// Link layer hooks
+uint8_t Connect_linkWrite( uint8_t num, const uint8_t *data, uint16_t len )
+{
+	Wire *wire = &wires[ num ];
+	if ( WireSize - wire->items < len )
+	{
+		wire->overflows++;
+		return 0;
+	}
+	for ( uint16_t c = 0; c < len; c++ )
+		wire->data[ ( wire->head + wire->items++ ) % WireSize ] = data[ c ];
+	return 1;
+}
+
+uint8_t Connect_linkDeliver( uint8_t num, uint8_t *payload, uint8_t len )
+{
+	Check *check = &checks[ num ];
+	uint8_t expected[ ConnectFrame_MaxPayload ];
+	uint32_t counter;
+	memcpy( &counter, payload, 4 );
+
+	// No room for it yet, the link layer must send it again
+	if ( now < check->busyUntil || uniform() < refuseRate )
+	{
+		check->refused++;
+		return 0;
+	}
+
+	if ( len < 4 || len != payloadFill( counter, expected ) || memcmp( payload, expected, len ) != 0 )
+	{
+		check->corrupted++;
+		return 1;
+	}
+	if ( counter < check->next )
+	{
+		check->reordered++;
+		return 1;
+	}
+
+	check->missing += counter - check->next;
+	check->next = counter + 1;
+	check->delivered++;
+
+	uint32_t latency = now - check->sentTime[ counter % 256 ];
+	check->latencyTotal += latency;
+	if ( latency > check->latencyMax )
+		check->latencyMax = latency;
+
+	return 1;
+}
+
+
+// Moves up to count bytes from wire num to the other side, flipping bits along the way
+void wireTransfer( uint8_t num, uint16_t count )
+{
+	Wire *wire = &wires[ num ];
+	ConnectLink *receiver = &links[ num ^ 1 ];
+
+	while ( count-- > 0 && wire->items > 0 )
+	{
+		uint8_t byte = wire->data[ wire->head ];
+		wire->head = ( wire->head + 1 ) % WireSize;
+		wire->items--;
+
+		for ( uint8_t bit = 0; bit < 8; bit++ )
+		{
+			if ( uniform() < bitErrorRate )
+			{
+				byte ^= 1 << bit;
+				wire->bitErrors++;
+			}
+		}
+
+		ConnectFrame_receive( receiver, byte, now );
+	}
+}
+
+// Streams payloads, whenever the window allows
+void linkSend( uint8_t num )
+{
+	Check *check = &checks[ num ^ 1 ];
+	uint8_t payload[ ConnectFrame_MaxPayload ];
+	uint8_t len = payloadFill( check->sent, payload );
+
+	if ( ConnectFrame_send( &links[ num ], payload, len, now ) )
+	{
+		check->sentTime[ check->sent % 256 ] = now;
+		check->sent++;
+	}
+}
+
+
+void printLink( const char *name, uint8_t num )
+{
+	ConnectLink *link = &links[ num ];
+	Check *check = &checks[ num ^ 1 ];
+
+	printf( "%s\n", name );
+	printf( "  Frames:     %u sent, %u delivered, %u dropped\n", link->framesSent, check->delivered, link->dropped );
+	printf( "  Wire:       %u bit errors, %u Tx overflows\n", wires[ num ].bitErrors, wires[ num ].overflows );
+	printf( "  Receiver:   %u CRC errors, %u NAKs sent, %u duplicates, %u resyncs\n",
+		links[ num ^ 1 ].crcErrors, links[ num ^ 1 ].naksSent, links[ num ^ 1 ].duplicates, links[ num ^ 1 ].resyncs );
+	printf( "  Sender:     %u NAKs received, %u retransmits, %u timeouts\n", link->naksReceived, link->retransmits, link->timeouts );
+	printf( "  Latency:    %.2f ms avg, %u ms max\n",
+		check->delivered > 0 ? (double)check->latencyTotal / check->delivered : 0.0, check->latencyMax );
+	printf( "  Refused:    %u deliveries, %u BSYs received\n", check->refused, link->busy );
+	printf( "  Failures:   %u corrupted, %u reordered, %u missing\n", check->corrupted, check->reordered, check->missing );
+}
+
+
+// Clears the links, wires and checks
+void loopbackReset()
+{
+	memset( wires, 0, sizeof( wires ) );
+	memset( checks, 0, sizeof( checks ) );
+	ConnectFrame_reset( &links[0], 0 );
+	ConnectFrame_reset( &links[1], 1 );
+}
+
+// A -> B on a clean wire, with B refusing every delivery for BusyTime ms
+// Returns the number of failures
+uint32_t busyTest( uint16_t bytesPerMs )
+{
+	Check *check = &checks[1];
+	uint32_t failures = 0;
+	uint32_t delivered = 0;
+	uint8_t acked = 0;
+
+	loopbackReset();
+
+	for ( now = 0; now < BusyStart + BusyTime + 1000; now++ )
+	{
+		if ( now == BusyStart )
+			check->busyUntil = BusyStart + BusyTime;
+
+		if ( now < BusyStart + BusyTime + 500 )
+			linkSend( 0 );
+
+		wireTransfer( 0, bytesPerMs );
+		wireTransfer( 1, bytesPerMs );
+
+		ConnectFrame_process( &links[0], now );
+		ConnectFrame_process( &links[1], now );
+
+		// Frames sent before the receiver got busy have settled, nothing may be delivered or acknowledged from now on
+		if ( now == BusyStart + UARTConnectRetransmit_define )
+		{
+			delivered = check->delivered;
+			acked = links[0].txAcked;
+		}
+		else if ( now > BusyStart + UARTConnectRetransmit_define && now < BusyStart + BusyTime
+			&& ( check->delivered != delivered || links[0].txAcked != acked ) )
+		{
+			printf( "Busy: frame delivered or acknowledged at %u ms while refusing\n", now );
+			failures++;
+			break;
+		}
+	}
+
+	printLink( "Busy A -> B", 0 );
+
+	// Refused frames were sent again, and all of them made it exactly once, in order
+	if ( check->refused == 0 || links[0].retransmits == 0 )
+		failures++;
+	if ( check->delivered != check->sent || check->missing || check->reordered || check->corrupted )
+		failures++;
+	if ( links[0].dropped || ConnectFrame_pending( &links[0] ) != 0 )
+		failures++;
+
+	return failures;
+}
+
+
+int main( int argc, char **argv )
+{
+	double errorRate = argc > 1 ? atof( argv[1] ) : 1e-4;
+	uint32_t seconds = argc > 2 ? atoi( argv[2] ) : 60;
+	uint32_t baud = argc > 3 ? atoi( argv[3] ) : 115200;
+	double refuse = argc > 4 ? atof( argv[4] ) : 1e-2;
+
+	// 8 data bits, parity, start and stop
+	uint16_t bytesPerMs = baud / 11 / 1000;
+	if ( bytesPerMs == 0 )
+		bytesPerMs = 1;
+
+	printf( "Busy for %u ms, at %u baud (%u bytes/ms), window %u, max payload %u\n",
+		BusyTime, baud, bytesPerMs, ConnectFrame_Window, ConnectFrame_MaxPayload );
+
+	uint32_t failures = busyTest( bytesPerMs );
+
+	loopbackReset();
+	bitErrorRate = errorRate;
+	refuseRate = refuse;
+
+	printf( "Bit error rate %g, refuse rate %g, %u s at %u baud (%u bytes/ms)\n",
+		bitErrorRate, refuseRate, seconds, baud, bytesPerMs );
+
+	uint32_t end = seconds * 1000;
+	for ( now = 0; now < end + 1000; now++ )
+	{
+		// Stop sending new frames for the last second, so everything in flight can finish
+		if ( now < end )
+		{
+			linkSend( 0 );
+			linkSend( 1 );
+		}
+
+		wireTransfer( 0, bytesPerMs );
+		wireTransfer( 1, bytesPerMs );
+
+		ConnectFrame_process( &links[0], now );
+		ConnectFrame_process( &links[1], now );
+	}
+
+	printLink( "A -> B", 0 );
+	printLink( "B -> A", 1 );
+
+	for ( uint8_t num = 0; num < 2; num++ )
+	{
+		Check *check = &checks[ num ^ 1 ];
+		failures += check->corrupted + check->reordered;
+
+		// Missing frames are only allowed if they were given up on, and nothing may still be in flight
+		if ( check->missing > links[ num ].dropped || ConnectFrame_pending( &links[ num ] ) != 0 )
+			failures++;
+	}
+
+	printf( failures ? "FAIL\n" : "PASS\n" );
+	return failures ? 1 : 0;
+}
+
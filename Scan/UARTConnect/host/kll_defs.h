@@ -0,0 +1,25 @@
+/* Copyright (C) 2015 by Jacob Alexander
+ *
+ * This file is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this file.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Host stand-in for the KLL generated defines used by connect_frame.c (see ../capabilities.kll)
+
+#pragma once
+
+#define UARTConnectBufSize_define    128
+#define UARTConnectWindow_define     4
+#define UARTConnectRetransmit_define 20
+#define UARTConnectRetries_define    8
+
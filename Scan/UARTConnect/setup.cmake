@@ -17,6 +17,7 @@ set ( SubModule 1 )
 # Module C files
 #
 set ( Module_SRCS
+	connect_frame.c
 	connect_scan.c
 )
 